@@ -2,17 +2,188 @@
 #define NXP_SIMTEMP_H
 
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
-#define MIN_TEMP (s32)-50000
-#define MAX_TEMP (s32)120000
+#define MIN_TEMP (__s32)-50000
+#define MAX_TEMP (__s32)120000
 
 /* Status flags for the sample */
 #define THRESHOLD_CROSSED  0x01
+#define SAMPLES_LOST       0x02  // Streaming only, samples were overwritten right before this one
 
 struct simtemp_sample {
-    u64 timestamp;        // timestamp since boot, in ms
-    s32 temp_mC;          // temperature in milli-Celsius
-    u32 flags;            // Sample flags
+    __u64 timestamp;      // timestamp since boot, in ms
+    __s32 temp_mC;        // temperature in milli-Celsius
+    __u32 flags;          // Sample flags
 } __attribute__((packed));
 
+/*
+ * Header placed in the first page of the mmap()ed ring buffer. The samples
+ * follow at data_offset. While the producer updates the ring, seq is odd;
+ * readers must retry if seq was odd or changed while they were copying.
+ */
+struct simtemp_ring_header {
+    __u32 seq;            // Update counter, odd while a push is in progress
+    __u32 capacity;       // Number of sample slots, a power of 2
+    __u32 head;           // Slot the next sample will be written to
+    __u32 len;            // Number of valid samples, oldest is at head - len
+    __u32 data_offset;    // Offset of slot 0 from the start of the mapping
+    __u32 reserved;
+    __u64 published;      // Number of samples pushed since the ring was created
+};
+
+/*
+ * Wakeup batching of a file descriptor waiting for the latest entry, see
+ * SIMTEMP_IOC_SET_BATCH. The defaults come from the batch_samples and
+ * batch_us sysfs attributes.
+ */
+struct simtemp_batch {
+    __u32 samples;        // Wake once this many new samples exist, at least 1
+    __u32 timeout_us;     // Or this long after the last consume, 0 to disable
+};
+
+#define SIMTEMP_IOC_MAGIC      's'
+/* A threshold transition always wakes up, regardless of the batching */
+#define SIMTEMP_IOC_SET_BATCH  _IOW(SIMTEMP_IOC_MAGIC, 1, struct simtemp_batch)
+#define SIMTEMP_IOC_GET_BATCH  _IOR(SIMTEMP_IOC_MAGIC, 2, struct simtemp_batch)
+
+/*
+ * Streaming reads. Every sample gets a sequence number, the ring's published
+ * count right after it was pushed, so the first sample ever is number 1 and
+ * the ring holds published - len + 1 up to published (see the ring header).
+ * A streaming handle reads every sample from its cursor on, in order and
+ * exactly once, instead of the latest one. Samples overwritten before they
+ * could be read are skipped, counted as lost, and the first sample read
+ * after them has SAMPLES_LOST set.
+ */
+struct simtemp_stream {
+    __u64 next_seq;       // Sequence number of the next sample to be read
+    __u64 lost;           // Samples lost since streaming was started
+};
+
+/* Start streaming from the given sequence number, 0 for the next new sample.
+ * The cursor can be older than the ring, those samples count as lost */
+#define SIMTEMP_IOC_STREAM_START  _IOW(SIMTEMP_IOC_MAGIC, 3, __u64)
+/* Back to reading the latest entry, the cursor becomes the consumed one */
+#define SIMTEMP_IOC_STREAM_STOP   _IO(SIMTEMP_IOC_MAGIC, 4)
+#define SIMTEMP_IOC_GET_STREAM    _IOR(SIMTEMP_IOC_MAGIC, 5, struct simtemp_stream)
+
+/* Move to the oldest sample with a timestamp at or after the given boot time
+ * in ns: the history position, or the stream cursor when streaming. Fails
+ * with ENODATA if there is none */
+#define SIMTEMP_IOC_SEEK_TIME     _IOW(SIMTEMP_IOC_MAGIC, 6, __u64)
+
+/*
+ * Downsampled history. Each tier summarizes the samples of fixed, boot time
+ * aligned periods into buckets, the newest of which is still being filled.
+ * Periods without samples (e.g. while the producer was parked) have no
+ * bucket at all.
+ */
+enum simtemp_rollup_tier {
+    SIMTEMP_ROLLUP_1S,    // 1 second buckets, the last 10 minutes
+    SIMTEMP_ROLLUP_1M,    // 1 minute buckets, the last 24 hours
+    SIMTEMP_ROLLUP_1H,    // 1 hour buckets, the last 30 days
+    SIMTEMP_ROLLUP_TIERS
+};
+
+struct simtemp_rollup_bucket {
+    __u64 timestamp;      // Boot time the period starts at, in ns
+    __s32 min_mC;
+    __s32 max_mC;
+    __s32 mean_mC;
+    __u32 count;          // Samples in the period
+};
+
+struct simtemp_rollup_query {
+    __u32 tier;           // enum simtemp_rollup_tier
+    __u32 count;          // In: room in buckets, out: buckets copied
+    __u64 buckets;        // Pointer to struct simtemp_rollup_bucket[count]
+};
+
+/* Copy the newest buckets of a tier, oldest first */
+#define SIMTEMP_IOC_READ_ROLLUP   _IOWR(SIMTEMP_IOC_MAGIC, 7, struct simtemp_rollup_query)
+
+/*
+ * Aggregates over the last `size` samples, also shown in the window/ sysfs
+ * directory. Exact, the sums are kept in integers.
+ */
+struct simtemp_window {
+    __u32 size;           // Window length, in samples
+    __u32 count;          // Samples in the window, size once it is full
+    __s32 min_mC;
+    __s32 max_mC;
+    __s32 mean_mC;        // Rounded towards 0
+    __u32 reserved;
+    __s64 sum_mC;
+    __u64 variance_mC2;   // Population variance, in (milli-Celsius)^2
+};
+
+#define SIMTEMP_IOC_GET_WINDOW    _IOR(SIMTEMP_IOC_MAGIC, 8, struct simtemp_window)
+
+/*
+ * Alarms, configured through the alarms/ sysfs directory. Each one asserts
+ * once the temperature reaches its threshold (rising), or drops to it
+ * (falling), and deasserts once it goes past threshold -/+ hysteresis the
+ * other way. Every transition is queued as an event, which each file
+ * descriptor drains on its own. poll() reports EPOLLRDBAND while a file
+ * descriptor has events to drain.
+ */
+#define SIMTEMP_ALARMS_MAX        8
+
+enum simtemp_alarm_severity {
+    SIMTEMP_ALARM_WARN,
+    SIMTEMP_ALARM_CRIT,
+    SIMTEMP_ALARM_SHUTDOWN
+};
+
+/* Event flags */
+#define SIMTEMP_ALARM_ASSERTED    0x01  // Cleared when the alarm deasserted
+#define SIMTEMP_ALARM_FALLING     0x02  // The alarm is a falling one
+
+struct simtemp_alarm_event {
+    __u64 timestamp;      // Of the sample that caused it, boot time in ns
+    __u64 sample_seq;     // Sequence number of that sample
+    __s32 temp_mC;
+    __u16 alarm;          // Index of the alarm, alarms/alarmN
+    __u8 severity;        // enum simtemp_alarm_severity
+    __u8 flags;
+};
+
+struct simtemp_alarm_read {
+    __u32 count;          // In: room in events, out: events copied
+    __u32 lost;           // Out: events overwritten before they could be read
+    __u64 events;         // Pointer to struct simtemp_alarm_event[count]
+};
+
+/* Copy the events the file descriptor has not read yet, oldest first. Never
+ * blocks, the count is 0 if there are none. New file descriptors start at
+ * the next event */
+#define SIMTEMP_IOC_READ_ALARMS   _IOWR(SIMTEMP_IOC_MAGIC, 9, struct simtemp_alarm_read)
+
+/*
+ * Traces for the replay mode, written to the replay/trace sysfs file or
+ * loaded from /lib/firmware through replay/firmware. A header, then the
+ * records in one of two formats, in native byte order:
+ * - SIMTEMP_TRACE_SAMPLES: struct simtemp_sample, as read() returns them.
+ *   Timestamps must not go backwards, flags are ignored.
+ * - SIMTEMP_TRACE_DELTA: per record, two LEB128 varints: the time since the
+ *   previous record in us (ignored for the first one, which plays first),
+ *   then the zigzag encoded change of temperature in milli-Celsius (from 0
+ *   for the first one). 2 to 4 bytes for a typical record.
+ * Every temperature must be in [MIN_TEMP, MAX_TEMP].
+ */
+#define SIMTEMP_TRACE_MAGIC       0x52545453  // "STTR" in little endian
+#define SIMTEMP_TRACE_VERSION     1
+
+enum simtemp_trace_format {
+    SIMTEMP_TRACE_SAMPLES,
+    SIMTEMP_TRACE_DELTA
+};
+
+struct simtemp_trace_header {
+    __u32 magic;          // SIMTEMP_TRACE_MAGIC
+    __u16 version;        // SIMTEMP_TRACE_VERSION
+    __u16 format;         // enum simtemp_trace_format
+};
+
 #endif
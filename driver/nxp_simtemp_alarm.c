@@ -0,0 +1,311 @@
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/minmax.h>
+#include <linux/limits.h>
+#include <linux/bits.h>
+
+#include "nxp_simtemp_alarm.h"
+
+/* Each alarm adds up to 2 boundaries, which split the range in bands */
+#define ALARM_BANDS_MAX (2 * SIMTEMP_ALARMS_MAX + 1)
+/* No band cached, the next sample looks it up and evaluates every alarm */
+#define ALARM_BAND_NONE U32_MAX
+
+/*
+ * Temperatures from lo up to the lo of the next band. Within a band, every
+ * alarm is either asserted (set), deasserted (clear), or in its hysteresis
+ * and keeps its state.
+ */
+struct alarm_band {
+        s32 lo;
+        u32 set;
+        u32 clear;
+};
+
+struct simtemp_alarms {
+        spinlock_t lock; /* Producer vs configuration and readers, which
+                          * take it with bh off */
+        struct simtemp_alarm_config config[SIMTEMP_ALARMS_MAX];
+        struct alarm_band bands[ALARM_BANDS_MAX];
+        u32 nbands;
+        u32 band;   /* Band of the latest sample */
+        u32 active; /* Asserted alarms, bit N is alarms/alarmN */
+
+        struct simtemp_alarm_event events[ALARM_EVENTS];
+        u64 queued; /* Events queued since created, the next one's slot */
+};
+
+struct simtemp_alarms *init_alarms(void)
+{
+        struct simtemp_alarms *alarms;
+
+        alarms = kzalloc(sizeof(struct simtemp_alarms), GFP_KERNEL);
+        if (!alarms)
+                return NULL;
+
+        /* All disabled, a single band with nothing to do */
+        alarms->nbands = 1;
+        alarms->bands[0].lo = S32_MIN;
+        alarms->band = ALARM_BAND_NONE;
+        spin_lock_init(&alarms->lock);
+
+        return alarms;
+}
+
+void destroy_alarms(struct simtemp_alarms *alarms)
+{
+        kfree(alarms);
+}
+
+/* Rising alarms assert at or above the threshold and deassert below
+ * threshold - hysteresis, falling ones the other way around */
+static bool alarm_asserts(const struct simtemp_alarm_config *config, s32 temp)
+{
+        return config->falling ? temp <= config->threshold_mC :
+                                 temp >= config->threshold_mC;
+}
+
+static bool alarm_deasserts(const struct simtemp_alarm_config *config, s32 temp)
+{
+        return config->falling ?
+                temp > config->threshold_mC + (s32)config->hysteresis_mC :
+                temp < config->threshold_mC - (s32)config->hysteresis_mC;
+}
+
+/**
+ * Precompute the bands from the configuration, so a sample that stays in the
+ * band of the previous one needs 2 comparisons, and one that doesn't a
+ * lookup among at most ALARM_BANDS_MAX bands. Disabled alarms deassert in
+ * every band.
+ * @param[in,out] alarms Alarms of the instance, with the lock held
+ */
+static void build_bands(struct simtemp_alarms *alarms)
+{
+        const struct simtemp_alarm_config *config;
+        s32 bounds[ALARM_BANDS_MAX - 1];
+        unsigned int i, j, nbounds = 0;
+        struct alarm_band *band;
+        s32 bound;
+
+        /* The first temperature of each region, the other edge of a
+         * region is an edge of the next one */
+        for (i = 0; i < SIMTEMP_ALARMS_MAX; i++) {
+                config = &alarms->config[i];
+                if (!config->enabled)
+                        continue;
+
+                if (config->falling) {
+                        bounds[nbounds++] = config->threshold_mC + 1;
+                        bounds[nbounds++] = config->threshold_mC +
+                                            (s32)config->hysteresis_mC + 1;
+                } else {
+                        bounds[nbounds++] = config->threshold_mC -
+                                            (s32)config->hysteresis_mC;
+                        bounds[nbounds++] = config->threshold_mC;
+                }
+        }
+
+        /* Few enough for an insertion sort */
+        for (i = 1; i < nbounds; i++) {
+                bound = bounds[i];
+                for (j = i; j && bounds[j - 1] > bound; j--)
+                        bounds[j] = bounds[j - 1];
+                bounds[j] = bound;
+        }
+
+        alarms->bands[0].lo = S32_MIN;
+        alarms->nbands = 1;
+        for (i = 0; i < nbounds; i++) {
+                if (bounds[i] != alarms->bands[alarms->nbands - 1].lo)
+                        alarms->bands[alarms->nbands++].lo = bounds[i];
+        }
+
+        /* Every alarm changes state only at a bound, so the first
+         * temperature of a band stands for all of it */
+        for (i = 0; i < alarms->nbands; i++) {
+                band = &alarms->bands[i];
+                band->set = 0;
+                band->clear = 0;
+                for (j = 0; j < SIMTEMP_ALARMS_MAX; j++) {
+                        config = &alarms->config[j];
+                        if (!config->enabled || alarm_deasserts(config, band->lo))
+                                band->clear |= BIT(j);
+                        else if (alarm_asserts(config, band->lo))
+                                band->set |= BIT(j);
+                }
+        }
+
+        /* Whatever the latest sample was, re-evaluate from the next one */
+        alarms->band = ALARM_BAND_NONE;
+}
+
+/**
+ * Get the configuration of an alarm
+ * @param[in] alarms Alarms of the instance
+ * @param[in] index Alarm to get, below SIMTEMP_ALARMS_MAX
+ * @param[out] config Its configuration
+ */
+void alarms_get_config(struct simtemp_alarms *alarms, unsigned int index,
+                       struct simtemp_alarm_config *config)
+{
+        spin_lock_bh(&alarms->lock);
+        *config = alarms->config[index];
+        spin_unlock_bh(&alarms->lock);
+}
+
+/**
+ * Replace the configuration of an alarm. It keeps its state until the next
+ * sample, which evaluates it against the new configuration. Disabling an
+ * asserted alarm deasserts it on the next sample, with an event.
+ * @param[in] alarms Alarms of the instance
+ * @param[in] index Alarm to set, below SIMTEMP_ALARMS_MAX
+ * @param[in] config New configuration, already validated
+ */
+void alarms_set_config(struct simtemp_alarms *alarms, unsigned int index,
+                       const struct simtemp_alarm_config *config)
+{
+        spin_lock_bh(&alarms->lock);
+        alarms->config[index] = *config;
+        build_bands(alarms);
+        spin_unlock_bh(&alarms->lock);
+}
+
+/**
+ * @return u32 - Mask of the asserted alarms, bit N being alarms/alarmN
+ */
+u32 alarms_get_active(struct simtemp_alarms *alarms)
+{
+        return READ_ONCE(alarms->active);
+}
+
+/**
+ * Binary search of the band a temperature is in
+ * @return u32 - Index of the band
+ */
+static u32 find_band(const struct simtemp_alarms *alarms, s32 temp)
+{
+        u32 lo = 0, hi = alarms->nbands - 1, mid;
+
+        /* Band 0 starts at S32_MIN, so the temperature is always in one */
+        while (lo < hi) {
+                mid = (lo + hi + 1) / 2;
+                if (temp >= alarms->bands[mid].lo)
+                        lo = mid;
+                else
+                        hi = mid - 1;
+        }
+
+        return lo;
+}
+
+static void queue_event(struct simtemp_alarms *alarms, unsigned int index, bool asserted,
+                        const struct simtemp_sample *sample, u64 sample_seq)
+{
+        const struct simtemp_alarm_config *config = &alarms->config[index];
+        struct simtemp_alarm_event *event;
+
+        event = &alarms->events[alarms->queued & (ALARM_EVENTS - 1)];
+        event->timestamp = sample->timestamp;
+        event->sample_seq = sample_seq;
+        event->temp_mC = sample->temp_mC;
+        event->alarm = index;
+        event->severity = config->severity;
+        event->flags = (asserted ? SIMTEMP_ALARM_ASSERTED : 0) |
+                       (config->falling ? SIMTEMP_ALARM_FALLING : 0);
+        alarms->queued++;
+}
+
+/**
+ * Evaluate every alarm against a sample, queueing an event for each one that
+ * changes state. Called by the producer for each sample it pushes, so from
+ * softirq context or with bottom halves disabled. While the temperature stays
+ * in the same band, which is most samples, no alarm can change state, so
+ * this is 2 comparisons.
+ * @param[in] alarms Alarms of the instance
+ * @param[in] sample Sample that was just pushed
+ * @param[in] sample_seq Its sequence number
+ * @return u32 - Number of events queued
+ */
+u32 alarms_check(struct simtemp_alarms *alarms, const struct simtemp_sample *sample,
+                 u64 sample_seq)
+{
+        const struct alarm_band *band;
+        u32 active, changed, events = 0;
+        s32 temp = sample->temp_mC;
+        unsigned int index;
+
+        spin_lock(&alarms->lock);
+
+        band = (ALARM_BAND_NONE == alarms->band) ? NULL : &alarms->bands[alarms->band];
+        if (band && temp >= band->lo &&
+            (alarms->band + 1 == alarms->nbands || temp < band[1].lo)) {
+                spin_unlock(&alarms->lock);
+                return 0;
+        }
+
+        alarms->band = find_band(alarms, temp);
+        band = &alarms->bands[alarms->band];
+        active = (alarms->active | band->set) & ~band->clear;
+        changed = active ^ alarms->active;
+        WRITE_ONCE(alarms->active, active);
+
+        for (index = 0; changed && index < SIMTEMP_ALARMS_MAX; index++) {
+                if (changed & BIT(index)) {
+                        queue_event(alarms, index, active & BIT(index), sample, sample_seq);
+                        events++;
+                }
+        }
+
+        spin_unlock(&alarms->lock);
+
+        return events;
+}
+
+/**
+ * @return u64 - Number of events queued since the instance was created, the
+ *               cursor of a reader that has seen all of them
+ */
+u64 alarms_get_queued(struct simtemp_alarms *alarms)
+{
+        u64 queued;
+
+        spin_lock_bh(&alarms->lock);
+        queued = alarms->queued;
+        spin_unlock_bh(&alarms->lock);
+
+        return queued;
+}
+
+/**
+ * Copy the events after a reader's cursor, oldest first, and move the cursor
+ * past them. Events that were overwritten before the reader got to them are
+ * skipped and counted.
+ * @param[in] alarms Alarms of the instance
+ * @param[in,out] cursor Events the reader has seen, see alarms_get_queued()
+ * @param[in] count Maximum number of events to copy
+ * @param[out] out_events Room for count events
+ * @param[out] lost Events skipped
+ * @return u32 - Number of events copied
+ */
+u32 alarms_read(struct simtemp_alarms *alarms, u64 *cursor, u32 count,
+                struct simtemp_alarm_event *out_events, u32 *lost)
+{
+        u32 i, len;
+
+        spin_lock_bh(&alarms->lock);
+
+        *lost = 0;
+        if (alarms->queued - *cursor > ALARM_EVENTS) {
+                *lost = alarms->queued - ALARM_EVENTS - *cursor;
+                *cursor = alarms->queued - ALARM_EVENTS;
+        }
+
+        len = min_t(u64, count, alarms->queued - *cursor);
+        for (i = 0; i < len; i++)
+                out_events[i] = alarms->events[(*cursor + i) & (ALARM_EVENTS - 1)];
+        *cursor += len;
+
+        spin_unlock_bh(&alarms->lock);
+
+        return len;
+}
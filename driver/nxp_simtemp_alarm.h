@@ -0,0 +1,36 @@
+#ifndef NXP_SIMTEMP_ALARM_H
+#define NXP_SIMTEMP_ALARM_H
+
+#include <linux/types.h>
+
+#include "nxp_simtemp.h"
+
+/* Events kept for the readers, a power of 2 */
+#define ALARM_EVENTS 256
+
+/* Configuration of one alarm, as set through its sysfs attribute */
+struct simtemp_alarm_config {
+    bool enabled;
+    bool falling;       /* Asserts at or below the threshold instead of above */
+    enum simtemp_alarm_severity severity;
+    s32 threshold_mC;
+    u32 hysteresis_mC;
+};
+
+/* Alarm table and event queue of an instance, opaque outside of the component */
+struct simtemp_alarms;
+
+struct simtemp_alarms *init_alarms(void);
+void destroy_alarms(struct simtemp_alarms *alarms);
+void alarms_get_config(struct simtemp_alarms *alarms, unsigned int index,
+                       struct simtemp_alarm_config *config);
+void alarms_set_config(struct simtemp_alarms *alarms, unsigned int index,
+                       const struct simtemp_alarm_config *config);
+u32 alarms_get_active(struct simtemp_alarms *alarms);
+u32 alarms_check(struct simtemp_alarms *alarms, const struct simtemp_sample *sample,
+                 u64 sample_seq);
+u64 alarms_get_queued(struct simtemp_alarms *alarms);
+u32 alarms_read(struct simtemp_alarms *alarms, u64 *cursor, u32 count,
+                struct simtemp_alarm_event *out_events, u32 *lost);
+
+#endif
@@ -2,110 +2,607 @@
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/atomic.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
 
-#define INDEX_MASK  (BUFFER_CAPACITY - 1)
+#define PEEK_ADVANCE_PTR(ptr, mask)  ((ptr + 1) & (mask))
+#define ADVANCE_PTR(ptr, mask)       ptr = ((ptr + 1) & (mask))
 
-#define PEEK_ADVANCE_PTR(ptr)  ((ptr + 1) & INDEX_MASK)
-#define ADVANCE_PTR(ptr)       ptr = ((ptr + 1) & INDEX_MASK)
+/* The header gets a page of its own so the samples start page aligned */
+#define HEADER_SIZE  PAGE_SIZE
+#define MAPPING_SIZE(capacity) (HEADER_SIZE + PAGE_ALIGN((capacity) * sizeof(struct simtemp_sample)))
 
+/*
+ * Backing storage of the ring. A resize replaces it as a whole, so readers
+ * reach it through RCU and never see a half-copied ring.
+ */
+struct ring_storage {
+    struct simtemp_ring_header *header; /* Start of the mmap()able area */
+    struct simtemp_sample *slots;
+    size_t capacity;
+    size_t mask;
+};
+
+/*
+ * head, tail and len are the writer's private copy of the ring state. Readers
+ * never take the lock: they go through the published header instead, and
+ * retry whenever its seq tells them a push raced with their copy.
+ */
 struct lifo_ring_buffer {
     size_t head, tail;
     size_t len;
-    rwlock_t lock;
-    void* buffer;
+    u64 published; /* Samples pushed so far, never reset */
+    spinlock_t lock; /* Serializes writers only */
+    struct mutex resize_lock; /* Serializes resizes against new mappings */
+    atomic_t mappings; /* VMAs currently mapping the storage */
+    struct ring_storage __rcu *storage;
 };
 
-static struct lifo_ring_buffer nxp_simtemp_buffer;
+/* Must be called with the writer lock held */
+static inline struct ring_storage *writer_storage(struct lifo_ring_buffer *rb)
+{
+    return rcu_dereference_protected(rb->storage,
+                                     lockdep_is_held(&rb->lock));
+}
 
-static inline int ring_buffer_is_full(void)
+static inline int ring_buffer_is_full(const struct lifo_ring_buffer *rb,
+                                      const struct ring_storage *storage)
 {
     /* Ring buffer is full if head is behind tail */
-    return (PEEK_ADVANCE_PTR(nxp_simtemp_buffer.head) == nxp_simtemp_buffer.tail);
+    return (PEEK_ADVANCE_PTR(rb->head, storage->mask) == rb->tail);
+}
+
+/**
+ * Mirror the ring state into the header seen by the mmap() readers.
+ * Must be called with the lock held, between the two seq increments.
+ */
+static inline void publish_header(const struct lifo_ring_buffer *rb,
+                                  struct simtemp_ring_header *header)
+{
+    WRITE_ONCE(header->head, rb->head);
+    WRITE_ONCE(header->len, rb->len);
+    WRITE_ONCE(header->published, rb->published);
+}
+
+static inline void header_write_begin(struct simtemp_ring_header *header)
+{
+    WRITE_ONCE(header->seq, header->seq + 1);
+    smp_wmb();
+}
+
+static inline void header_write_end(struct simtemp_ring_header *header)
+{
+    smp_wmb();
+    WRITE_ONCE(header->seq, header->seq + 1);
+}
+
+/**
+ * Start a lockless read section. Waits out a push in progress, which is
+ * short since the writer can't be preempted while holding the lock.
+ * @param[in] header Header of the storage being read
+ * @return u32 - seq snapshot to pass to header_read_retry()
+ */
+static inline u32 header_read_begin(const struct simtemp_ring_header *header)
+{
+    u32 seq;
+
+    while ((seq = READ_ONCE(header->seq)) & 1)
+        cpu_relax();
+    smp_rmb();
+
+    return seq;
+}
+
+/**
+ * End a lockless read section.
+ * @param[in] header Header of the storage being read
+ * @param[in] seq Value returned by header_read_begin()
+ * @return bool - True if a writer got in the way and the read must be redone
+ */
+static inline bool header_read_retry(const struct simtemp_ring_header *header, u32 seq)
+{
+    smp_rmb();
+    return READ_ONCE(header->seq) != seq;
+}
+
+/**
+ * Allocate an empty storage.
+ * @param[in] capacity Number of slots, must be a power of 2
+ * @return struct ring_storage* - New storage, NULL if out of memory
+ */
+static struct ring_storage *alloc_ring_storage(size_t capacity)
+{
+    struct ring_storage *storage;
+
+    storage = kzalloc(sizeof(struct ring_storage), GFP_KERNEL);
+    if (!storage)
+        return NULL;
+
+    /* vmalloc_user() hands out zeroed pages that remap_vmalloc_range() accepts */
+    storage->header = vmalloc_user(MAPPING_SIZE(capacity));
+    if (!storage->header) {
+        kfree(storage);
+        return NULL;
+    }
+
+    storage->header->capacity = capacity;
+    storage->header->data_offset = HEADER_SIZE;
+    storage->slots = (struct simtemp_sample *)((u8 *)storage->header + HEADER_SIZE);
+    storage->capacity = capacity;
+    storage->mask = capacity - 1;
+
+    return storage;
+}
+
+static void free_ring_storage(struct ring_storage *storage)
+{
+    vfree(storage->header);
+    kfree(storage);
+}
+
+struct lifo_ring_buffer *init_ring_buffer(void)
+{
+    struct lifo_ring_buffer *rb;
+    struct ring_storage *storage;
+
+    rb = kzalloc(sizeof(struct lifo_ring_buffer), GFP_KERNEL);
+    if (!rb)
+        return NULL;
+
+    rb->head = 0;
+    rb->tail = 0;
+    rb->len = 0;
+    rb->published = 0;
+    spin_lock_init(&rb->lock);
+    mutex_init(&rb->resize_lock);
+    atomic_set(&rb->mappings, 0);
+
+    storage = alloc_ring_storage(BUFFER_CAPACITY);
+    if (!storage) {
+        kfree(rb);
+        return NULL;
+    }
+
+    RCU_INIT_POINTER(rb->storage, storage);
+
+    return rb;
+}
+
+void destroy_ring_buffer(struct lifo_ring_buffer *rb)
+{
+    /* Producer and readers are gone by now */
+    free_ring_storage(rcu_dereference_protected(rb->storage, 1));
+    mutex_destroy(&rb->resize_lock);
+    kfree(rb);
+}
+
+/**
+ * Lockless copy of the newest samples of a storage.
+ * @param[in] storage Storage to copy from, RCU protected
+ * @param[out] out_samples Destination, room for max samples
+ * @param[in] max Maximum number of samples to copy
+ * @param[out] published Published count the copy is consistent with
+ * @return size_t - Number of samples copied, oldest first
+ */
+static size_t copy_newest(const struct ring_storage *storage,
+                          struct simtemp_sample *out_samples, size_t max, u64 *published)
+{
+    u32 seq;
+    size_t len, offset, first;
+
+    do {
+        seq = header_read_begin(storage->header);
+
+        *published = READ_ONCE(storage->header->published);
+        len = min_t(size_t, READ_ONCE(storage->header->len), max);
+
+        offset = (READ_ONCE(storage->header->head) - len) & storage->mask;
+        first = min(len, storage->capacity - offset);
+        memcpy(out_samples, &storage->slots[offset], first * sizeof(struct simtemp_sample));
+        memcpy(&out_samples[first], storage->slots, (len - first) * sizeof(struct simtemp_sample));
+    } while (header_read_retry(storage->header, seq));
+
+    return len;
+}
+
+int ring_buffer_resize(struct lifo_ring_buffer *rb, size_t capacity)
+{
+    struct ring_storage *old, *new;
+    size_t keep, copied, total;
+    u64 snapshot, delta;
+    int retval = 0;
+
+    if ((capacity < BUFFER_CAPACITY_MIN) || (capacity > BUFFER_CAPACITY_MAX))
+        return -ERANGE;
+
+    capacity = roundup_pow_of_two(capacity);
+    /* One slot always stays free, see ring_buffer_is_full() */
+    keep = capacity - 1;
+
+    mutex_lock(&rb->resize_lock);
+
+    /* A mapping would keep looking at the old storage */
+    if (atomic_read(&rb->mappings)) {
+        retval = -EBUSY;
+        goto unlock;
+    }
+
+    new = alloc_ring_storage(capacity);
+    if (!new) {
+        retval = -ENOMEM;
+        goto unlock;
+    }
+
+    /*
+     * The bulk of the copy runs without the writer lock so the producer
+     * isn't held off for the length of a multi-megabyte memcpy. Only the
+     * samples pushed in the meantime are copied with the lock held.
+     */
+    old = rcu_dereference_protected(rb->storage,
+                                    lockdep_is_held(&rb->resize_lock));
+    copied = copy_newest(old, new->slots, keep, &snapshot);
+
+    spin_lock_bh(&rb->lock);
+
+    /* Pushes only ever append, clearing is kept out by the resize lock */
+    delta = rb->published - snapshot;
+    if (delta < min(rb->len, keep)) {
+        /* The new storage is used as a ring from here, wrapping drops the oldest */
+        for (size_t i = 0; i < delta; i++)
+            new->slots[(copied + i) & new->mask] =
+                old->slots[(rb->head - delta + i) & old->mask];
+        total = copied + delta;
+    } else {
+        /* The producer lapped the copy, start over from what's in the ring now */
+        total = min(rb->len, keep);
+        for (size_t i = 0; i < total; i++)
+            new->slots[i] = old->slots[(rb->head - total + i) & old->mask];
+    }
+
+    rb->len = min(total, keep);
+    rb->head = total & new->mask;
+    rb->tail = (rb->head - rb->len) & new->mask;
+    publish_header(rb, new->header);
+
+    rcu_assign_pointer(rb->storage, new);
+    spin_unlock_bh(&rb->lock);
+
+    /* Readers still copying out of the old storage must be done first */
+    synchronize_rcu();
+    free_ring_storage(old);
+
+unlock:
+    mutex_unlock(&rb->resize_lock);
+    return retval;
+}
+
+size_t get_ring_buffer_capacity(struct lifo_ring_buffer *rb)
+{
+    size_t retval;
+
+    rcu_read_lock();
+    retval = rcu_dereference(rb->storage)->capacity;
+    rcu_read_unlock();
+
+    return retval;
 }
 
-int init_ring_buffer(void)
+static void ring_buffer_vm_open(struct vm_area_struct *vma)
 {
-    nxp_simtemp_buffer.head = 0;
-    nxp_simtemp_buffer.tail = 0;
-    nxp_simtemp_buffer.len = 0;
-    rwlock_init(&nxp_simtemp_buffer.lock);
+    struct lifo_ring_buffer *rb = vma->vm_private_data;
 
-    nxp_simtemp_buffer.buffer = kzalloc(BUFFER_CAPACITY * sizeof(struct simtemp_sample), GFP_KERNEL);
+    atomic_inc(&rb->mappings);
+}
 
-    if (!nxp_simtemp_buffer.buffer)
-        return -ENOMEM;
+static void ring_buffer_vm_close(struct vm_area_struct *vma)
+{
+    struct lifo_ring_buffer *rb = vma->vm_private_data;
 
-    return 0;
+    atomic_dec(&rb->mappings);
 }
 
-void destroy_ring_buffer(void)
+static const struct vm_operations_struct ring_buffer_vm_ops = {
+    .open = ring_buffer_vm_open,
+    .close = ring_buffer_vm_close,
+};
+
+int ring_buffer_mmap(struct lifo_ring_buffer *rb, struct vm_area_struct *vma)
 {
-    kfree(nxp_simtemp_buffer.buffer);
+    struct ring_storage *storage;
+    int retval;
+
+    /* Consumers only get to look, the producer is the only writer */
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+
+    vm_flags_clear(vma, VM_MAYWRITE);
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+
+    /* Keeps the storage from being swapped while it gets mapped */
+    mutex_lock(&rb->resize_lock);
+    storage = rcu_dereference_protected(rb->storage,
+                                        lockdep_is_held(&rb->resize_lock));
+
+    /* Rejects mappings that go past the end of the area */
+    retval = remap_vmalloc_range(vma, storage->header, vma->vm_pgoff);
+    if (!retval) {
+        vma->vm_private_data = rb;
+        vma->vm_ops = &ring_buffer_vm_ops;
+        ring_buffer_vm_open(vma);
+    }
+
+    mutex_unlock(&rb->resize_lock);
+
+    return retval;
 }
 
-void ring_buffer_push(struct simtemp_sample* entry)
+/**
+ * Push a new entry into the ring, overwriting the oldest one if full.
+ * @param[in] rb Ring to push into
+ * @param[in] entry Sample to copy into the ring
+ * @return bool - True if the oldest entry was overwritten
+ */
+bool ring_buffer_push(struct lifo_ring_buffer *rb, struct simtemp_sample* entry)
 {
-    /* Acquire write lock, no bh because the only caller should be the timer callback */
-    write_lock(&nxp_simtemp_buffer.lock);
+    struct ring_storage *storage;
+    bool overwritten = false;
+
+    /* Acquire writer lock, no bh because the only caller should be the timer callback */
+    spin_lock(&rb->lock);
+    storage = writer_storage(rb);
+    header_write_begin(storage->header);
 
     /* If buffer is full, tail moves one over and entry overwrite the freed space */
-    if (ring_buffer_is_full()) {
-        ADVANCE_PTR(nxp_simtemp_buffer.tail);
+    if (ring_buffer_is_full(rb, storage)) {
+        ADVANCE_PTR(rb->tail, storage->mask);
+        overwritten = true;
     } else {
         /* Non-full buffer means we can increase the len further */
-        nxp_simtemp_buffer.len++;
+        rb->len++;
     }
 
-    (void)memcpy(&((struct simtemp_sample *)nxp_simtemp_buffer.buffer)[nxp_simtemp_buffer.head], 
+    (void)memcpy(&storage->slots[rb->head],
                 entry,
                 sizeof(struct simtemp_sample));
 
-    ADVANCE_PTR(nxp_simtemp_buffer.head);
-    write_unlock(&nxp_simtemp_buffer.lock);
+    ADVANCE_PTR(rb->head, storage->mask);
+    rb->published++;
+
+    publish_header(rb, storage->header);
+    header_write_end(storage->header);
+    spin_unlock(&rb->lock);
+
+    return overwritten;
 }
 
-int ring_buffer_peek(size_t index, struct simtemp_sample *out_sample)
+int ring_buffer_peek(struct lifo_ring_buffer *rb, size_t index,
+                     struct simtemp_sample *out_sample)
 {
-    /* Acquire read lock */
-    read_lock_bh(&nxp_simtemp_buffer.lock);
+    return (ring_buffer_peek_range(rb, index, 1, out_sample, NULL) == 1) ? 0 : -1;
+}
 
-    if (index >= nxp_simtemp_buffer.len) {
-        read_unlock_bh(&nxp_simtemp_buffer.lock);
-        return -1;
-    }
+/**
+ * Copy len entries starting index entries after the oldest one. Must be
+ * called in a read section, with ring_len and head read from it.
+ */
+static inline void copy_span(const struct ring_storage *storage, size_t head,
+                             size_t ring_len, size_t index, size_t len,
+                             struct simtemp_sample *out_samples)
+{
+    size_t offset, first;
+
+    /* A span crossing the end of the storage is split in two copies */
+    offset = (head - ring_len + index) & storage->mask;
+    first = min(len, storage->capacity - offset);
+    memcpy(out_samples, &storage->slots[offset], first * sizeof(struct simtemp_sample));
+    memcpy(&out_samples[first], storage->slots, (len - first) * sizeof(struct simtemp_sample));
+}
+
+size_t ring_buffer_peek_range(struct lifo_ring_buffer *rb, size_t index, size_t count,
+                              struct simtemp_sample *out_samples, u64 *published)
+{
+    const struct ring_storage *storage;
+    u32 seq;
+    size_t ring_len, len;
+
+    rcu_read_lock();
+    storage = rcu_dereference(rb->storage);
+
+    do {
+        seq = header_read_begin(storage->header);
+        len = 0;
+
+        if (published)
+            *published = READ_ONCE(storage->header->published);
+
+        ring_len = READ_ONCE(storage->header->len);
+        if (index >= ring_len)
+            continue;
+        len = min(count, ring_len - index);
+
+        copy_span(storage, READ_ONCE(storage->header->head), ring_len, index, len,
+                  out_samples);
+    } while (header_read_retry(storage->header, seq));
+
+    rcu_read_unlock();
+
+    return len;
+}
 
-    size_t offset = (nxp_simtemp_buffer.tail + index) & INDEX_MASK;
-    memcpy( out_sample, 
-            &((struct simtemp_sample *)nxp_simtemp_buffer.buffer)[offset],
-            sizeof(struct simtemp_sample));
-    
-    read_unlock_bh(&nxp_simtemp_buffer.lock);
+/**
+ * Copy entries by sequence number. The entries in the ring are always the
+ * ones numbered published - len + 1 up to published, oldest first.
+ * @param[in] rb Ring to copy from
+ * @param[in] first_seq Sequence number of the first entry wanted
+ * @param[in] count Maximum number of entries to copy
+ * @param[out] out_samples Room for count entries
+ * @param[out] out_seq Sequence number of the first entry copied. Higher
+ *                     than first_seq if those entries were overwritten
+ * @return size_t - Number of entries copied, 0 if first_seq isn't out yet
+ */
+size_t ring_buffer_peek_seq(struct lifo_ring_buffer *rb, u64 first_seq, size_t count,
+                            struct simtemp_sample *out_samples, u64 *out_seq)
+{
+    const struct ring_storage *storage;
+    u32 seq;
+    u64 published, oldest, start;
+    size_t ring_len, len;
+
+    rcu_read_lock();
+    storage = rcu_dereference(rb->storage);
+
+    do {
+        seq = header_read_begin(storage->header);
+        len = 0;
+
+        published = READ_ONCE(storage->header->published);
+        ring_len = READ_ONCE(storage->header->len);
+        oldest = published - ring_len + 1;
+        start = max(first_seq, oldest);
+        *out_seq = start;
+        if (start > published)
+            continue;
+        len = min_t(u64, count, published - start + 1);
+
+        copy_span(storage, READ_ONCE(storage->header->head), ring_len, start - oldest, len,
+                  out_samples);
+    } while (header_read_retry(storage->header, seq));
+
+    rcu_read_unlock();
+
+    return len;
+}
+
+/**
+ * Binary search for the oldest entry with a timestamp at or after the given
+ * one. Relies on entries being pushed in timestamp order.
+ * @param[in] rb Ring to search
+ * @param[in] timestamp Boot time to look for, in ns
+ * @param[out] len Number of entries in the ring when it was searched
+ * @param[out] published Published count when it was searched
+ * @return size_t - Index of the entry, from the oldest, len if none is recent enough
+ */
+size_t ring_buffer_find_timestamp(struct lifo_ring_buffer *rb, u64 timestamp,
+                                  size_t *len, u64 *published)
+{
+    const struct ring_storage *storage;
+    u32 seq;
+    size_t ring_len, head, low, high, mid;
+
+    rcu_read_lock();
+    storage = rcu_dereference(rb->storage);
+
+    do {
+        seq = header_read_begin(storage->header);
+
+        *published = READ_ONCE(storage->header->published);
+        ring_len = READ_ONCE(storage->header->len);
+        head = READ_ONCE(storage->header->head);
+
+        /* Lower bound over [low, high) */
+        low = 0;
+        high = ring_len;
+        while (low < high) {
+            mid = low + (high - low) / 2;
+            if (READ_ONCE(storage->slots[(head - ring_len + mid) & storage->mask].timestamp) < timestamp)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+    } while (header_read_retry(storage->header, seq));
 
-    return 0;
+    rcu_read_unlock();
+
+    *len = ring_len;
+    return low;
 }
 
-int ring_buffer_peek_latest(struct simtemp_sample *out_sample)
+int ring_buffer_peek_latest(struct lifo_ring_buffer *rb,
+                            struct simtemp_sample *out_sample, u64 *published)
 {
-    return ring_buffer_peek(nxp_simtemp_buffer.len-1, out_sample);
+    const struct ring_storage *storage;
+    int retval;
+    u32 seq;
+    size_t offset;
+
+    rcu_read_lock();
+    storage = rcu_dereference(rb->storage);
+
+    do {
+        seq = header_read_begin(storage->header);
+        retval = 0;
+
+        if (published)
+            *published = READ_ONCE(storage->header->published);
+
+        if (0 == READ_ONCE(storage->header->len)) {
+            retval = -1;
+            continue;
+        }
+
+        offset = (READ_ONCE(storage->header->head) - 1) & storage->mask;
+        memcpy( out_sample,
+                &storage->slots[offset],
+                sizeof(struct simtemp_sample));
+    } while (header_read_retry(storage->header, seq));
+
+    rcu_read_unlock();
+
+    return retval;
 }
 
-void clear_ring_buffer(void)
+void clear_ring_buffer(struct lifo_ring_buffer *rb)
 {
-    /* Acquire write lock, with bh since could be called outside of softIRQ context */
-    write_lock_bh(&nxp_simtemp_buffer.lock);
-    nxp_simtemp_buffer.head = 0;
-    nxp_simtemp_buffer.tail = 0;
-    nxp_simtemp_buffer.len = 0;
-    write_unlock_bh(&nxp_simtemp_buffer.lock);
+    struct ring_storage *storage;
+
+    /* A resize in progress relies on the ring only growing */
+    mutex_lock(&rb->resize_lock);
+
+    /* Acquire writer lock, with bh since could be called outside of softIRQ context */
+    spin_lock_bh(&rb->lock);
+    storage = writer_storage(rb);
+    header_write_begin(storage->header);
+    rb->head = 0;
+    rb->tail = 0;
+    rb->len = 0;
+    publish_header(rb, storage->header);
+    header_write_end(storage->header);
+    spin_unlock_bh(&rb->lock);
+
+    mutex_unlock(&rb->resize_lock);
 }
 
-size_t get_ring_buffer_size(void)
+size_t get_ring_buffer_size(struct lifo_ring_buffer *rb)
 {
     size_t retval;
-    /* Acquire read lock */
-    read_lock_bh(&nxp_simtemp_buffer.lock);
-    retval = nxp_simtemp_buffer.len;
-    read_unlock_bh(&nxp_simtemp_buffer.lock);
+
+    /* A single aligned word, no read section needed */
+    rcu_read_lock();
+    retval = READ_ONCE(rcu_dereference(rb->storage)->header->len);
+    rcu_read_unlock();
+
+    return retval;
+}
+
+u64 ring_buffer_get_published(struct lifo_ring_buffer *rb)
+{
+    const struct ring_storage *storage;
+    u64 retval;
+    u32 seq;
+
+    rcu_read_lock();
+    storage = rcu_dereference(rb->storage);
+
+    /* Read section only matters where 64-bit loads can tear */
+    do {
+        seq = header_read_begin(storage->header);
+        retval = READ_ONCE(storage->header->published);
+    } while (header_read_retry(storage->header, seq));
+
+    rcu_read_unlock();
 
     return retval;
 }
@@ -3,14 +3,33 @@
 
 #include "nxp_simtemp.h"
 
-#define BUFFER_CAPACITY (128) // should be a power of 2
+struct vm_area_struct;
 
-int init_ring_buffer(void);
-void destroy_ring_buffer(void);
-void ring_buffer_push(struct simtemp_sample* entry);
-int ring_buffer_peek(size_t index, struct simtemp_sample *out_sample);
-int ring_buffer_peek_latest(struct simtemp_sample *out_sample);
-void clear_ring_buffer(void);
-size_t get_ring_buffer_size(void);
+#define BUFFER_CAPACITY (128) // should be a power of 2, default until resized
+#define BUFFER_CAPACITY_MIN (2)
+#define BUFFER_CAPACITY_MAX (1 << 24) // 256 MiB of samples
+
+/* One ring per device instance, opaque outside of the buffer component */
+struct lifo_ring_buffer;
+
+struct lifo_ring_buffer *init_ring_buffer(void);
+void destroy_ring_buffer(struct lifo_ring_buffer *rb);
+int ring_buffer_resize(struct lifo_ring_buffer *rb, size_t capacity);
+size_t get_ring_buffer_capacity(struct lifo_ring_buffer *rb);
+bool ring_buffer_push(struct lifo_ring_buffer *rb, struct simtemp_sample* entry);
+int ring_buffer_peek(struct lifo_ring_buffer *rb, size_t index,
+                     struct simtemp_sample *out_sample);
+size_t ring_buffer_peek_range(struct lifo_ring_buffer *rb, size_t index, size_t count,
+                              struct simtemp_sample *out_samples, u64 *published);
+size_t ring_buffer_peek_seq(struct lifo_ring_buffer *rb, u64 first_seq, size_t count,
+                            struct simtemp_sample *out_samples, u64 *out_seq);
+size_t ring_buffer_find_timestamp(struct lifo_ring_buffer *rb, u64 timestamp,
+                                  size_t *len, u64 *published);
+int ring_buffer_peek_latest(struct lifo_ring_buffer *rb,
+                            struct simtemp_sample *out_sample, u64 *published);
+void clear_ring_buffer(struct lifo_ring_buffer *rb);
+size_t get_ring_buffer_size(struct lifo_ring_buffer *rb);
+u64 ring_buffer_get_published(struct lifo_ring_buffer *rb);
+int ring_buffer_mmap(struct lifo_ring_buffer *rb, struct vm_area_struct *vma);
 
 #endif
@@ -1,56 +1,77 @@
 
 /******************** MACROS ********************/
 
-#define NXP_SIMTEMP_MINOR_COUNT 1
+/* Upper bound on the number of instances, one minor each */
+#define NXP_SIMTEMP_MINOR_COUNT 256
 #define NXP_SIMTEMP_DRIVER_NAME "nxp_simtemp"
 #define NXP_SIMTEMP_CLASS_NAME "nxp_simtemp"
 #define NXP_SIMTEMP_DEVICE_NAME "simtemp"
+#define NXP_SIMTEMP_NODE_NAME NXP_SIMTEMP_DEVICE_NAME "%d"
 
 #define pr_fmt(fmt) NXP_SIMTEMP_DRIVER_NAME ": " fmt
 
-#define SAMPLE_BUFFER_SIZE   10
+/* Samples copied to userspace per bounce buffer round, 64 KiB with 4K pages */
+#define READ_CHUNK_SAMPLES   ((16 * PAGE_SIZE) / sizeof(struct simtemp_sample))
 
 /******************** INCLUDES ********************/
 
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <asm/atomic.h>
 #include <linux/wait.h>
 #include <linux/ktime.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
 #include <linux/jiffies.h>
-#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/math64.h>
 #include <linux/platform_device.h>
 #include <linux/mod_devicetable.h>
+#include <linux/property.h>
+#include <linux/idr.h>
 #include <linux/poll.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/uaccess.h>
+#include <linux/compat.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/bottom_half.h>
+#include <uapi/linux/sched/types.h>
 
 #include "nxp_simtemp.h"
 #include "nxp_simtemp_buffer.h"
 #include "nxp_simtemp_sysfs.h"
 #include "nxp_simtemp_generators.h"
+#include "nxp_simtemp_core.h"
+#include "nxp_simtemp_offset.h"
+#include "nxp_simtemp_rollup.h"
+#include "nxp_simtemp_window.h"
+#include "nxp_simtemp_alarm.h"
+#include "nxp_simtemp_replay.h"
+#include "nxp_simtemp_producer.h"
 
 /******************** DATA TYPES ********************/
 
-/**
- * Struct containing the objects and state pertaining to the device 
- */
-typedef struct nxp_simtemp_device {
-        dev_t devnum;          /* Device number range */
-        struct device *device; /* Device instance in /dev */
-        struct cdev cdev;      /* The char device struct for fops */
-        bool in_threshold;     /* Temp threshold state */
-        spinlock_t consumers_lock; /* Consumer list lock */
-        struct list_head consumers; /* Consumer list */
-} nxp_simtemp_dev_t;
-
 /**
  * Struct for each process that interacts with the device
  */
 typedef struct nxp_simtemp_dev_handle{
-        atomic_t latest_available;
+        nxp_simtemp_dev_t *simtemp_dev; /* Instance the handle was opened on */
+        u64 consumed_seq; /* Published count when the latest entry was consumed,
+                           * the sequence number of the last one when streaming */
+        u64 consumed_ns; /* Monotonic time of that, or of the open() */
+        u32 batch_samples; /* New samples to wait for, see struct simtemp_batch */
+        u64 batch_ns; /* Or time since consumed_ns, 0 if disabled */
         u32 entry_idx; /* Index of ring buffer entry */
-        struct list_head node; /* Consumer node for the consumers list */ 
+        bool mapped; /* Samples are read through mmap(), not read() */
+        bool streaming; /* read() returns every sample after consumed_seq */
+        u64 lost; /* Samples overwritten before they were streamed */
+        u64 alarm_seq; /* Alarm events queued when last drained */
 } nxp_simtemp_dev_handle_t;
 
 /******************** FUNCTION PROTOTYPES ********************/
@@ -62,10 +83,13 @@ static ssize_t nxp_simtemp_read(struct file *file, char __user *out_buff,
                                 size_t req_len, loff_t *loff);
 static loff_t nxp_simtemp_llseek(struct file * file, loff_t loff, int whence);
 static __poll_t nxp_simtemp_poll(struct file *file, struct poll_table_struct *wait);
+static int nxp_simtemp_mmap(struct file *file, struct vm_area_struct *vma);
 static int nxp_simtemp_release(struct inode *inode, struct file *file);
+static long nxp_simtemp_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 
-static bool validate_threshold(struct simtemp_sample *sample);
 static void generate_temperature(struct timer_list *data);
+static enum hrtimer_restart generate_temperature_hr(struct hrtimer *timer);
+static int generate_temperature_thread(void *data);
 
 /******************** PUBLIC CONST ********************/
 
@@ -106,6 +130,9 @@ static const struct file_operations nxp_simtemp_fops = {
     .read = nxp_simtemp_read,
     .llseek = nxp_simtemp_llseek,
     .poll = nxp_simtemp_poll,
+    .mmap = nxp_simtemp_mmap,
+    .unlocked_ioctl = nxp_simtemp_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
     .release = nxp_simtemp_release,
 };
 
@@ -113,79 +140,291 @@ static const struct file_operations nxp_simtemp_fops = {
 
 /******************** STATIC VARIABLES ********************/
 
-static struct platform_device *simtemp_pdev;
-static nxp_simtemp_dev_t simtemp_dev;
+#ifndef USE_DTS
+/* Without a DT, instances are created by the module itself */
+static unsigned int instances = 1;
+module_param(instances, uint, 0444);
+MODULE_PARM_DESC(instances, "Number of simulated sensors to create");
+
+static struct platform_device **simtemp_pdevs;
+#endif
 
-static struct timer_list nxp_simtemp_tmr;
-static DECLARE_WAIT_QUEUE_HEAD(nxp_simtemp_wq);
+/* Device numbers shared by all instances, the minor is the instance id */
+static dev_t simtemp_devnum;
+static DEFINE_IDA(simtemp_minors);
 
 /******************** FUNCTION IMPLEMENTATION ********************/
 
 /**
- * Validate if the sample has crossed or cleared the temperature threshold
- * @param[in,out]  sample - Sample to validate, might have its THRESHOLD_CROSSED
- *                          modified, depending on the conditions
- * @return bool - True if threshold has been crossed, False otherwise or if
- *                hysteresis band has been cleared
+ * Callback for the ktimer, the low-power default backend.
  */
-static bool validate_threshold(struct simtemp_sample *sample)
-{
-        bool retval = false;
-
-        if (sample->temp_mC >= threshold_mC) 
-                simtemp_dev.in_threshold = true;
-        
-        if (simtemp_dev.in_threshold) {
-                if (sample->temp_mC <= (threshold_mC - (s32)hysteresis_mC)) {
-                        sample->flags &= ~THRESHOLD_CROSSED;
-                        simtemp_dev.in_threshold = false;
-                } else {
-                        sample->flags |= THRESHOLD_CROSSED;
-                        retval = true;
-                }
-        }
+static void generate_temperature(struct timer_list *timer)
+{
+        nxp_simtemp_dev_t *simtemp_dev = from_timer(simtemp_dev, timer, tmr);
+        ktime_t next = producer_tick(simtemp_dev);
+        s64 delay_ns = ktime_to_ns(ktime_sub(next, ktime_get_boottime()));
 
-        return retval;
+        /* Round up, the tick must not come in before its deadline */
+        (void)mod_timer(&simtemp_dev->tmr, 
+                        jiffies + nsecs_to_jiffies(max_t(s64, delay_ns, 0) + TICK_NSEC - 1));
 }
 
 /**
- * Callback for the ktimer. 
- * Gets a sample from the active generator and notifies consumers of new data.
+ * Callback for the hrtimer backend, for sampling periods below the tick.
+ * Runs in softirq context (HRTIMER_MODE_ABS_SOFT) like the ktimer does,
+ * as that is what the ring buffer push expects.
  */
-static void generate_temperature(struct timer_list *timer)
+static enum hrtimer_restart generate_temperature_hr(struct hrtimer *timer)
 {
-        struct simtemp_sample sample;
-        nxp_simtemp_dev_handle_t* consumer;
+        nxp_simtemp_dev_t *simtemp_dev = container_of(timer, nxp_simtemp_dev_t, hrtmr);
+
+        hrtimer_set_expires(timer, producer_tick(simtemp_dev));
 
-        /* Get the newest sample */
-        get_temp_sample(&sample);
-        (void)validate_threshold(&sample);
-        ring_buffer_push(&sample);
+        return HRTIMER_RESTART;
+}
 
-        /* Notify consumers that new data is available */
-        spin_lock(&simtemp_dev.consumers_lock);
-        list_for_each_entry(consumer, &simtemp_dev.consumers, node){
-                atomic_set(&consumer->latest_available, 1);
+/**
+ * Body of the kthread backend, for nodes that want the producer off the
+ * softirq path. Sleeps on an hrtimer until each deadline, then ticks in
+ * process context, at the scheduling class and on the CPU configured.
+ * @param data[in] Instance to produce for
+ * @return int - Always 0, once kthread_stop() was called
+ */
+static int generate_temperature_thread(void *data)
+{
+        nxp_simtemp_dev_t *simtemp_dev = data;
+        ktime_t next = ktime_add_ns(simtemp_dev->tick_epoch, simtemp_dev->tick_period_ns);
+
+        for (;;) {
+                /* Set before checking, so a kthread_stop() can't be missed */
+                set_current_state(TASK_IDLE);
+                if (kthread_should_stop())
+                        break;
+
+                (void)schedule_hrtimeout_range_clock(&next, 0, HRTIMER_MODE_ABS,
+                                                     CLOCK_BOOTTIME);
+                if (kthread_should_stop())
+                        break;
+
+                /* The ring writer lock is also taken from the timer
+                 * backends' softirqs, so it has to be taken with bottom
+                 * halves off here. Anything they raised meanwhile runs on
+                 * local_bh_enable(), at this thread's priority. */
+                local_bh_disable();
+                next = producer_tick(simtemp_dev);
+                local_bh_enable();
         }
-        spin_unlock(&simtemp_dev.consumers_lock);
+        __set_current_state(TASK_RUNNING);
 
-        wake_up_interruptible_sync(&nxp_simtemp_wq);
-        (void)mod_timer(&nxp_simtemp_tmr, 
-                        jiffies + msecs_to_jiffies(sampling_ms));
+        return 0;
 }
 
-static int init_timer(void)
+/**
+ * Create the producer kthread, bound and prioritized as configured.
+ * @param simtemp_dev[in] Instance to produce for
+ * @return int - 0 on success, or the negative error code
+ */
+static int start_producer_thread(nxp_simtemp_dev_t *simtemp_dev)
 {
-        timer_setup(&nxp_simtemp_tmr, generate_temperature, 0);
-        nxp_simtemp_tmr.expires = jiffies + msecs_to_jiffies(sampling_ms);
-        add_timer(&nxp_simtemp_tmr);
+        struct sched_attr attr = {
+                .size = sizeof(attr),
+                .sched_policy = SCHED_FIFO,
+                .sched_priority = simtemp_dev->params.producer_prio,
+        };
+        s32 cpu = simtemp_dev->params.producer_cpu;
+        struct task_struct *task;
+        int retval;
+
+        task = kthread_create(generate_temperature_thread, simtemp_dev,
+                              NXP_SIMTEMP_NODE_NAME, MINOR(simtemp_dev->devnum));
+        if (IS_ERR(task))
+                return PTR_ERR(task);
+
+        /* Settings that can't be applied only cost the thread its placement */
+        if (cpu >= 0) {
+                retval = set_cpus_allowed_ptr(task, cpumask_of(cpu));
+                if (retval)
+                        dev_warn(simtemp_dev->device,
+                                 "Can't bind the producer to CPU %d: %d\n", cpu, retval);
+        }
+
+        if (attr.sched_priority) {
+                retval = sched_setattr_nocheck(task, &attr);
+                if (retval)
+                        dev_warn(simtemp_dev->device,
+                                 "Can't make the producer SCHED_FIFO: %d\n", retval);
+        }
+
+        simtemp_dev->producer_task = task;
+        wake_up_process(task);
 
         return 0;
 }
 
-static void free_timer(void)
+/**
+ * Whether the producer should be ticking. Not before the probe is done,
+ * and on demand, only while the device is open.
+ * Must be called with producer_lock held.
+ * @param simtemp_dev[in] Instance to check
+ * @return bool - True if the producer should run
+ */
+static bool producer_wanted(const nxp_simtemp_dev_t *simtemp_dev)
+{
+        return simtemp_dev->producer_enabled &&
+               (!simtemp_dev->params.ondemand || simtemp_dev->consumers);
+}
+
+/* Must be called with producer_lock held */
+static void start_producer(nxp_simtemp_dev_t *simtemp_dev)
 {
-        timer_shutdown_sync(&nxp_simtemp_tmr);
+        u64 period_ns = simtemp_dev->params.sampling_us * NSEC_PER_USEC;
+        int retval;
+
+        /* Schedule restarts from here, the first tick is one period away */
+        simtemp_dev->tick_period_ns = period_ns;
+        simtemp_dev->tick_epoch = ktime_get_boottime();
+        simtemp_dev->tick_count = 1;
+
+        simtemp_dev->active_producer = simtemp_dev->params.producer;
+        simtemp_dev->producer_running = true;
+
+        switch (simtemp_dev->active_producer) {
+        case simtemp_producer_hrtimer:
+                hrtimer_start(&simtemp_dev->hrtmr,
+                              ktime_add_ns(simtemp_dev->tick_epoch, period_ns),
+                              HRTIMER_MODE_ABS_SOFT);
+                break;
+        case simtemp_producer_kthread:
+                retval = start_producer_thread(simtemp_dev);
+                if (!retval)
+                        break;
+
+                /* Better a producer in softirq than none at all */
+                dev_err(simtemp_dev->device,
+                        "Failed to start the producer thread: %d, using the timer\n",
+                        retval);
+                simtemp_dev->active_producer = simtemp_producer_timer;
+                fallthrough;
+        case simtemp_producer_timer:
+        default:
+                /* Not pending after stop_producer(), so its flags can change */
+                timer_setup(&simtemp_dev->tmr, generate_temperature,
+                            simtemp_dev->params.deferrable ? TIMER_DEFERRABLE : 0);
+                (void)mod_timer(&simtemp_dev->tmr, 
+                                jiffies + nsecs_to_jiffies(period_ns + TICK_NSEC - 1));
+                break;
+        }
+}
+
+/* Must be called with producer_lock held */
+static void stop_producer(nxp_simtemp_dev_t *simtemp_dev)
+{
+        if (!simtemp_dev->producer_running)
+                return;
+
+        switch (simtemp_dev->active_producer) {
+        case simtemp_producer_hrtimer:
+                (void)hrtimer_cancel(&simtemp_dev->hrtmr);
+                break;
+        case simtemp_producer_kthread:
+                /* Wakes the thread from its sleep and waits for it to exit */
+                (void)kthread_stop(simtemp_dev->producer_task);
+                simtemp_dev->producer_task = NULL;
+                break;
+        case simtemp_producer_timer:
+        default:
+                /* Also waits for a running callback, which may re-arm it */
+                (void)del_timer_sync(&simtemp_dev->tmr);
+                break;
+        }
+
+        simtemp_dev->producer_running = false;
+}
+
+/**
+ * Stop the running producer backend and start the configured one, if the
+ * producer should be running at all.
+ * Sleeps, must be called from process context.
+ * @param simtemp_dev[in] Instance whose producer is restarted
+ */
+void restart_producer(nxp_simtemp_dev_t *simtemp_dev)
+{
+        mutex_lock(&simtemp_dev->producer_lock);
+        stop_producer(simtemp_dev);
+        if (producer_wanted(simtemp_dev))
+                start_producer(simtemp_dev);
+        mutex_unlock(&simtemp_dev->producer_lock);
+}
+
+/**
+ * Restart the generators from a seed. The producer is stopped around it, as
+ * the generator state is its own, so every sample after the call comes from
+ * the new sequence.
+ * Sleeps, must be called from process context.
+ * @param simtemp_dev[in] Instance to reseed
+ * @param seed[in] New seed, see the `seed` attribute
+ */
+void reseed_producer(nxp_simtemp_dev_t *simtemp_dev, u64 seed)
+{
+        mutex_lock(&simtemp_dev->producer_lock);
+        stop_producer(simtemp_dev);
+        simtemp_dev->params.seed = seed;
+        init_gen_state(&simtemp_dev->gen, &simtemp_dev->params);
+        if (producer_wanted(simtemp_dev))
+                start_producer(simtemp_dev);
+        mutex_unlock(&simtemp_dev->producer_lock);
+}
+
+/* Before the cdev and attributes are exposed, they can start the producer */
+static void init_timer(nxp_simtemp_dev_t *simtemp_dev)
+{
+        mutex_init(&simtemp_dev->producer_lock);
+        timer_setup(&simtemp_dev->tmr, generate_temperature, 0);
+        /* Boot time, so deadlines can be used as sample timestamps */
+        hrtimer_init(&simtemp_dev->hrtmr, CLOCK_BOOTTIME, HRTIMER_MODE_ABS_SOFT);
+        simtemp_dev->hrtmr.function = generate_temperature_hr;
+}
+
+/* Once everything the producer touches is in place */
+static void enable_producer(nxp_simtemp_dev_t *simtemp_dev)
+{
+        mutex_lock(&simtemp_dev->producer_lock);
+        simtemp_dev->producer_enabled = true;
+        if (!simtemp_dev->producer_running && producer_wanted(simtemp_dev))
+                start_producer(simtemp_dev);
+        mutex_unlock(&simtemp_dev->producer_lock);
+}
+
+static void free_timer(nxp_simtemp_dev_t *simtemp_dev)
+{
+        mutex_lock(&simtemp_dev->producer_lock);
+        simtemp_dev->producer_enabled = false;
+        stop_producer(simtemp_dev);
+        timer_shutdown_sync(&simtemp_dev->tmr);
+        mutex_unlock(&simtemp_dev->producer_lock);
+        mutex_destroy(&simtemp_dev->producer_lock);
+}
+
+/**
+ * Lower a wakeup registration to val, unless it is lower already
+ */
+static void atomic64_lower(atomic64_t *v, s64 val)
+{
+        s64 old = atomic64_read(v);
+
+        while ((val < old) && !atomic64_try_cmpxchg(v, &old, val))
+                ;
+}
+
+/**
+ * Mark the latest entry as consumed up to the given published count
+ * @param dev_handle[in] Consumer specific handle
+ * @param published[in] Published count the consumed entry belongs to
+ */
+static void consume_latest(nxp_simtemp_dev_handle_t *dev_handle, u64 published)
+{
+        WRITE_ONCE(dev_handle->consumed_seq, published);
+        WRITE_ONCE(dev_handle->consumed_ns, ktime_get_ns());
 }
 
 /**
@@ -195,38 +434,89 @@ static void free_timer(void)
  */
 static bool check_data_available(const nxp_simtemp_dev_handle_t *dev_handle)
 {
+        const nxp_simtemp_dev_t *simtemp_dev = dev_handle->simtemp_dev;
+        u64 consumed = READ_ONCE(dev_handle->consumed_seq);
+        u64 published, batch_ns;
+
         /* Any entry other than the latest is always available */
-        bool retval = true;
+        if (UINT_MAX != dev_handle->entry_idx)
+                return true;
 
-        /* if the idx is for the latest entry, we need to check the
-         * availability flag */
-        if (UINT_MAX == dev_handle->entry_idx) 
-                retval = atomic_read(&dev_handle->latest_available);
+        /* For the latest entry, something must have been published since it
+         * was last consumed. Then, enough of it to fill the handle's batch,
+         * or for long enough, unless the threshold was crossed or cleared */
+        published = ring_buffer_get_published(simtemp_dev->ring);
+        if (published == consumed)
+                return false;
 
-        return retval;
+        if (published - consumed >= READ_ONCE(dev_handle->batch_samples))
+                return true;
+
+        if (READ_ONCE(simtemp_dev->threshold_seq) > consumed)
+                return true;
+
+        batch_ns = READ_ONCE(dev_handle->batch_ns);
+        return batch_ns && (ktime_get_ns() - READ_ONCE(dev_handle->consumed_ns) >= batch_ns);
+}
+
+/**
+ * Register the handle's batch with the producer, then check if data is
+ * available. Used by waiters, before going (back) to sleep.
+ * @param dev_handle[in] Consumer specific handle
+ * @return bool - True if data can be read, false otherwise
+ */
+static bool arm_wakeup(nxp_simtemp_dev_handle_t *dev_handle)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_handle->simtemp_dev;
+        u64 batch_ns = READ_ONCE(dev_handle->batch_ns);
+
+        if (UINT_MAX == dev_handle->entry_idx) {
+                atomic64_lower(&simtemp_dev->wake_target,
+                               READ_ONCE(dev_handle->consumed_seq) +
+                               READ_ONCE(dev_handle->batch_samples));
+                if (batch_ns)
+                        atomic64_lower(&simtemp_dev->wake_deadline,
+                                       READ_ONCE(dev_handle->consumed_ns) + batch_ns);
+        }
+
+        /* Pairs with the barrier in notify_consumers() */
+        smp_mb();
+        return check_data_available(dev_handle);
 }
 
 static int nxp_simtemp_open(struct inode *inode, struct file *file)
 {
+        nxp_simtemp_dev_t *simtemp_dev = 
+                container_of(inode->i_cdev, nxp_simtemp_dev_t, cdev);
+
         /* Check if module is not being unloaded */
         if (!try_module_get(THIS_MODULE))
                 return -ENODEV;
 
-        /* Create the device handle and add process to the list of consumers */
+        /* Create the device handle */
         struct nxp_simtemp_dev_handle *dev_handle = 
                 kzalloc(sizeof(struct nxp_simtemp_dev_handle), GFP_KERNEL);
         if (!dev_handle)
                 return -ENOMEM;
 
         /* Our open policy is that it accesses the end of the ring buffer
-         * (aka the latest entry). UINT_MAX will be used to symbolize this */
-        atomic_set(&dev_handle->latest_available, 0); 
+         * (aka the latest entry). UINT_MAX will be used to symbolize this.
+         * What is already there counts as consumed, we wait for a new one */
+        dev_handle->simtemp_dev = simtemp_dev;
+        dev_handle->consumed_seq = ring_buffer_get_published(simtemp_dev->ring);
+        dev_handle->consumed_ns = ktime_get_ns();
         dev_handle->entry_idx = UINT_MAX;
-        
-        /* Add process to the consumers list */
-        spin_lock_bh(&simtemp_dev.consumers_lock);
-        list_add_tail(&dev_handle->node, &simtemp_dev.consumers);
-        spin_unlock_bh(&simtemp_dev.consumers_lock);
+        dev_handle->batch_samples = simtemp_dev->params.batch_samples;
+        dev_handle->batch_ns = (u64)simtemp_dev->params.batch_us * NSEC_PER_USEC;
+        dev_handle->alarm_seq = alarms_get_queued(simtemp_dev->alarms);
+
+        /* On demand, the first consumer starts the producer. The generator
+         * state is kept across stops, so the signal picks up where it was */
+        mutex_lock(&simtemp_dev->producer_lock);
+        simtemp_dev->consumers++;
+        if (!simtemp_dev->producer_running && producer_wanted(simtemp_dev))
+                start_producer(simtemp_dev);
+        mutex_unlock(&simtemp_dev->producer_lock);
 
         /* Finally, add ourselves to the file pointer */
         file->private_data = (void *)dev_handle;
@@ -236,47 +526,16 @@ static int nxp_simtemp_open(struct inode *inode, struct file *file)
 
 static loff_t nxp_simtemp_llseek(struct file * file, loff_t loff, int whence)
 {
-        int idx_offset;
-        int new_pos;
-        size_t size;
-
         nxp_simtemp_dev_handle_t *dev_handle = 
                 (nxp_simtemp_dev_handle_t *)file->private_data;
-        
-        /* Reject partial seek requests */
-        if (loff != 0)
-                if ((size_t)abs(loff) <  sizeof(struct simtemp_sample))
-                        return -EINVAL;
 
-        idx_offset = loff / sizeof(struct simtemp_sample);
-        size = get_ring_buffer_size();
-
-        switch (whence) {
-        case SEEK_SET:
-                new_pos = idx_offset;
-                break;
-        case SEEK_CUR:
-                new_pos = idx_offset + dev_handle->entry_idx;
-                break;
-        case SEEK_END:
-                new_pos = idx_offset + size - 1;
-                break;
-        default:
-                return -EINVAL;
-        }
-
-        /* Check if the new position is within entry [0, size-1] */
-        if ((new_pos < 0) || (new_pos >= size)) 
-                return -EINVAL;
+        /* The stream has a cursor of its own */
+        if (dev_handle->streaming)
+                return -ESPIPE;
 
-        /* If entry[size-1] is requested (e.g. by calling seek(dev, 0, SEEK_END)
-         * latch position to the last entry */
-        if (new_pos == size - 1)
-                dev_handle->entry_idx = UINT_MAX;
-        else 
-                dev_handle->entry_idx = new_pos;
-        
-        return new_pos * sizeof(struct simtemp_sample);
+        return simtemp_seek(loff, whence, dev_handle->entry_idx,
+                            get_ring_buffer_size(dev_handle->simtemp_dev->ring),
+                            &dev_handle->entry_idx);
 }
 
 static __poll_t nxp_simtemp_poll(struct file *file, struct poll_table_struct *wait)
@@ -284,41 +543,183 @@ static __poll_t nxp_simtemp_poll(struct file *file, struct poll_table_struct *wa
         __poll_t retval = 0;    
         nxp_simtemp_dev_handle_t *dev_handle = 
                 (nxp_simtemp_dev_handle_t *)file->private_data;
+        nxp_simtemp_dev_t *simtemp_dev = dev_handle->simtemp_dev;
 
-        poll_wait(file, &nxp_simtemp_wq, wait);
+        poll_wait(file, &simtemp_dev->wq, wait);
 
         /* When not looking at the latest entry, data is always available */
         if (dev_handle->entry_idx != UINT_MAX)  {
                 retval |= POLLIN | POLLRDNORM;
-        } else {
-                /* For the lastest entry, see if it is available and handle
-                 * special threshold event */
-                if (atomic_read(&dev_handle->latest_available)) {
-                        retval |= POLLIN | POLLRDNORM;
-                        if (simtemp_dev.in_threshold)
-                                retval |= POLLPRI;
-                }
+        } else if (arm_wakeup(dev_handle)) {
+                /* For the lastest entry, handle the special threshold event.
+                 * Mapped handles never call read() to consume the entry, so
+                 * reporting it does that instead */
+                if (dev_handle->mapped && !dev_handle->streaming)
+                        consume_latest(dev_handle,
+                                       ring_buffer_get_published(simtemp_dev->ring));
+
+                retval |= POLLIN | POLLRDNORM;
+                if (simtemp_dev->in_threshold)
+                        retval |= POLLPRI;
         }
 
+        /* Alarm events are drained apart from the samples */
+        if (alarms_get_queued(simtemp_dev->alarms) != READ_ONCE(dev_handle->alarm_seq))
+                retval |= POLLRDBAND;
+
+        if (retval)
+                STAT_INC(simtemp_dev, poll_wakeups);
+
+        return retval;
+}
+
+/**
+ * Map the ring buffer read-only into the caller. The first page holds a
+ * struct simtemp_ring_header, the sample slots follow at its data_offset.
+ * The mapping does not touch the handle's offset. From now on, a poll()
+ * reporting POLLIN for the latest entry also marks it as consumed, so
+ * poll() can be used purely as a new-sample notification.
+ */
+static int nxp_simtemp_mmap(struct file *file, struct vm_area_struct *vma)
+{
+        int retval;
+        nxp_simtemp_dev_handle_t *dev_handle = 
+                (nxp_simtemp_dev_handle_t *)file->private_data;
+
+        retval = ring_buffer_mmap(dev_handle->simtemp_dev->ring, vma);
+        if (!retval)
+                dev_handle->mapped = true;
+
         return retval;
 }
 
+/**
+ * Copy history entries to userspace, starting at the handle's entry_idx.
+ * Entries go through a bounce buffer of up to READ_CHUNK_SAMPLES, each chunk
+ * being a single ring_buffer_peek_range() call, so a read of the whole
+ * history only takes a handful of copies.
+ * @return ssize_t - Number of entries copied, or negative error code
+ */
+static ssize_t read_history(nxp_simtemp_dev_handle_t *dev_handle,
+                            char __user *out_buff, size_t count)
+{
+        struct lifo_ring_buffer *ring = dev_handle->simtemp_dev->ring;
+        struct simtemp_sample *chunk_buffer;
+        size_t size, chunk, copied = 0;
+        u64 published = 0;
+
+        /* Limit requested samples to the available ones */
+        size = get_ring_buffer_size(ring);
+        count = simtemp_history_count(count, size, dev_handle->entry_idx);
+        if (0 == count)
+                return 0;
+
+        chunk_buffer = kvmalloc_array(min_t(size_t, count, READ_CHUNK_SAMPLES),
+                                      sizeof(struct simtemp_sample), GFP_KERNEL);
+        if (!chunk_buffer)
+                return -ENOMEM;
+
+        while (copied < count) {
+                chunk = ring_buffer_peek_range(ring, dev_handle->entry_idx,
+                                               min_t(size_t, count - copied, READ_CHUNK_SAMPLES),
+                                               chunk_buffer, &published);
+                if (0 == chunk)
+                        break;
+
+                if (copy_to_user(out_buff + copied * sizeof(struct simtemp_sample), 
+                                 chunk_buffer, chunk * sizeof(struct simtemp_sample))) {
+                        kvfree(chunk_buffer);
+                        return -EFAULT;
+                }
+
+                copied += chunk;
+                dev_handle->entry_idx += chunk;
+        }
+        kvfree(chunk_buffer);
+
+        /* If the end of the ring buffer was reached, latch to the latest
+         * entry. If the latest entry was part of the read, it is consumed */
+        size = get_ring_buffer_size(ring);
+        if (dev_handle->entry_idx >= size)
+                consume_latest(dev_handle, published);
+        if (dev_handle->entry_idx >= size - 1)
+                dev_handle->entry_idx = UINT_MAX;
+
+        return copied;
+}
+
+/**
+ * Copy the samples after the stream cursor to userspace, in order, and move
+ * the cursor past them. Samples the producer overwrote before they could be
+ * copied are skipped, counted in the handle, and the first sample after them
+ * is flagged with SAMPLES_LOST.
+ * @return ssize_t - Number of entries copied, or negative error code
+ */
+static ssize_t read_stream(nxp_simtemp_dev_handle_t *dev_handle,
+                           char __user *out_buff, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_handle->simtemp_dev;
+        struct simtemp_sample *chunk_buffer;
+        size_t chunk, copied = 0;
+        u64 next_seq, first_seq;
+
+        chunk_buffer = kvmalloc_array(min_t(size_t, count, READ_CHUNK_SAMPLES),
+                                      sizeof(struct simtemp_sample), GFP_KERNEL);
+        if (!chunk_buffer)
+                return -ENOMEM;
+
+        while (copied < count) {
+                next_seq = dev_handle->consumed_seq + 1;
+                chunk = ring_buffer_peek_seq(simtemp_dev->ring, next_seq,
+                                             min_t(size_t, count - copied, READ_CHUNK_SAMPLES),
+                                             chunk_buffer, &first_seq);
+                if (0 == chunk)
+                        break;
+
+                if (first_seq != next_seq)
+                        chunk_buffer[0].flags |= SAMPLES_LOST;
+
+                /* The cursor only moves past what userspace actually got */
+                if (copy_to_user(out_buff + copied * sizeof(struct simtemp_sample),
+                                 chunk_buffer, chunk * sizeof(struct simtemp_sample))) {
+                        kvfree(chunk_buffer);
+                        return copied ? copied : -EFAULT;
+                }
+
+                if (first_seq != next_seq) {
+                        dev_handle->lost += first_seq - next_seq;
+                        STAT_ADD(simtemp_dev, samples_lost, first_seq - next_seq);
+                }
+                copied += chunk;
+                consume_latest(dev_handle, first_seq + chunk - 1);
+        }
+        kvfree(chunk_buffer);
+
+        return copied;
+}
+
 static ssize_t nxp_simtemp_read(struct file *file, char __user *out_buff, 
                                 size_t req_len, loff_t *loff)
 {
-        struct simtemp_sample sample_buffer[SAMPLE_BUFFER_SIZE];
-        size_t count = 0;
-        size_t available_samples;
+        struct simtemp_sample sample;
+        ssize_t count = 0;
+        bool waited = false;
+        u64 published;
 
         nxp_simtemp_dev_handle_t *dev_handle = 
                 (nxp_simtemp_dev_handle_t *)file->private_data;
 
         while (!check_data_available(dev_handle)) {
-                if(file->f_flags & O_NONBLOCK)
+                if(file->f_flags & O_NONBLOCK) {
+                        STAT_INC(dev_handle->simtemp_dev, eagain_returns);
                         return -EAGAIN;
+                }
 
-                if (wait_event_interruptible(nxp_simtemp_wq, check_data_available(dev_handle)))
+                STAT_INC(dev_handle->simtemp_dev, blocking_waits);
+                if (wait_event_interruptible(dev_handle->simtemp_dev->wq,
+                                             arm_wakeup(dev_handle)))
                         return -ERESTARTSYS;
+                waited = true;
         }
 
         /* Check how much of the request, if any, can be supplied */
@@ -328,51 +729,192 @@ static ssize_t nxp_simtemp_read(struct file *file, char __user *out_buff,
                 return -EINVAL;
         }
 
-        /* Check if latest was requested */
-        if (UINT_MAX == dev_handle->entry_idx) {
-                /* Clear the availabity flag, as entry is consumed */
-                ring_buffer_peek_latest(&sample_buffer[0]);
-                atomic_set(&dev_handle->latest_available, 0);
+        if (dev_handle->streaming) {
+                count = read_stream(dev_handle, out_buff, count);
+                if (count < 0)
+                        return count;
+        } else if (UINT_MAX == dev_handle->entry_idx) {
+                /* Latest was requested, latch the published count the
+                 * entry belongs to, as it is now consumed */
+                ring_buffer_peek_latest(dev_handle->simtemp_dev->ring, &sample,
+                                        &published);
+                consume_latest(dev_handle, published);
+                if (copy_to_user(out_buff, &sample, sizeof(struct simtemp_sample)))
+                        return -EFAULT;
                 count = 1;
-        } else {
-                /* Limit requested samples to the available ones */
-                available_samples = get_ring_buffer_size() - dev_handle->entry_idx;
-                if (count > available_samples)
-                        count = available_samples;
-
-                /* Limit to capacity of write buffer */
-                if (count > SAMPLE_BUFFER_SIZE)
-                        count = SAMPLE_BUFFER_SIZE;
-
-                /* Read all requested samples into the write buffer */
-                for (size_t buff_idx = 0; buff_idx < count; buff_idx++) {
-                        ring_buffer_peek(dev_handle->entry_idx, 
-                                        &sample_buffer[buff_idx]);
-                        dev_handle->entry_idx++;
-                }
 
-                /* If the end of the ring buffer was reached, latch to the 
-                *  latest entry */
-               if (dev_handle->entry_idx == (get_ring_buffer_size()-1))
-                        dev_handle->entry_idx = UINT_MAX;
+                /* Only a reader that slept measures the whole delivery */
+                if (waited)
+                        hist_record(dev_handle->simtemp_dev->delivery_latency,
+                                    ktime_get_ns() -
+                                    READ_ONCE(dev_handle->simtemp_dev->last_push_ns));
+        } else {
+                count = read_history(dev_handle, out_buff, count);
+                if (count < 0)
+                        return count;
         }
 
-        if (copy_to_user(out_buff, sample_buffer, count * sizeof(struct simtemp_sample)))
-                return -EFAULT;
+        STAT_INC(dev_handle->simtemp_dev, reads_served);
+        STAT_ADD(dev_handle->simtemp_dev, bytes_copied, count * sizeof(struct simtemp_sample));
 
         *loff = dev_handle->entry_idx * sizeof(struct simtemp_sample);
         return count * sizeof(struct simtemp_sample);
 }
 
+static long nxp_simtemp_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+        nxp_simtemp_dev_handle_t *dev_handle = 
+                (nxp_simtemp_dev_handle_t *)file->private_data;
+        nxp_simtemp_dev_t *simtemp_dev = dev_handle->simtemp_dev;
+        void __user *user_arg = (void __user *)arg;
+        struct simtemp_stream stream;
+        struct simtemp_batch batch;
+        struct simtemp_rollup_query query;
+        struct simtemp_rollup_bucket *buckets;
+        struct simtemp_window window;
+        struct simtemp_alarm_read alarm_read;
+        struct simtemp_alarm_event *events;
+        u64 published, start_seq, timestamp;
+        size_t index, size;
+        int retval;
+
+        switch (cmd) {
+        case SIMTEMP_IOC_SET_BATCH:
+                if (copy_from_user(&batch, user_arg, sizeof(batch)))
+                        return -EFAULT;
+
+                if (0 == batch.samples)
+                        return -EINVAL;
+
+                WRITE_ONCE(dev_handle->batch_samples, batch.samples);
+                WRITE_ONCE(dev_handle->batch_ns, (u64)batch.timeout_us * NSEC_PER_USEC);
+                /* Let waiters on this handle re-register with the new batch */
+                wake_up_interruptible(&simtemp_dev->wq);
+                return 0;
+
+        case SIMTEMP_IOC_GET_BATCH:
+                batch.samples = READ_ONCE(dev_handle->batch_samples);
+                batch.timeout_us = div_u64(READ_ONCE(dev_handle->batch_ns), NSEC_PER_USEC);
+                if (copy_to_user(user_arg, &batch, sizeof(batch)))
+                        return -EFAULT;
+                return 0;
+
+        case SIMTEMP_IOC_STREAM_START:
+                if (copy_from_user(&start_seq, user_arg, sizeof(start_seq)))
+                        return -EFAULT;
+
+                published = ring_buffer_get_published(simtemp_dev->ring);
+                if (0 == start_seq)
+                        start_seq = published + 1;
+                else if (start_seq > published + 1)
+                        return -EINVAL;
+
+                /* The stream reuses the latest entry's wait logic, with the
+                 * cursor in consumed_seq */
+                dev_handle->entry_idx = UINT_MAX;
+                dev_handle->lost = 0;
+                consume_latest(dev_handle, start_seq - 1);
+                WRITE_ONCE(dev_handle->streaming, true);
+                wake_up_interruptible(&simtemp_dev->wq);
+                return 0;
+
+        case SIMTEMP_IOC_STREAM_STOP:
+                WRITE_ONCE(dev_handle->streaming, false);
+                return 0;
+
+        case SIMTEMP_IOC_SEEK_TIME:
+                if (copy_from_user(&timestamp, user_arg, sizeof(timestamp)))
+                        return -EFAULT;
+
+                index = ring_buffer_find_timestamp(simtemp_dev->ring, timestamp,
+                                                   &size, &published);
+                if (index >= size)
+                        return -ENODATA;
+
+                /* Same as seeking to the index, the last entry latches onto
+                 * the latest one */
+                if (dev_handle->streaming)
+                        consume_latest(dev_handle, published - size + index);
+                else
+                        dev_handle->entry_idx = (index == size - 1) ? UINT_MAX : index;
+                return 0;
+
+        case SIMTEMP_IOC_READ_ROLLUP:
+                if (copy_from_user(&query, user_arg, sizeof(query)))
+                        return -EFAULT;
+
+                buckets = kvmalloc_array(min_t(u32, query.count, ROLLUP_DEPTH_MAX),
+                                         sizeof(struct simtemp_rollup_bucket), GFP_KERNEL);
+                if (!buckets)
+                        return -ENOMEM;
+
+                /* Copied out under the rollup lock, so to userspace after */
+                retval = rollup_read(simtemp_dev->rollup, query.tier,
+                                     min_t(u32, query.count, ROLLUP_DEPTH_MAX), buckets);
+                if (retval >= 0) {
+                        query.count = retval;
+                        if (copy_to_user(u64_to_user_ptr(query.buckets), buckets,
+                                         query.count * sizeof(struct simtemp_rollup_bucket)) ||
+                            copy_to_user(user_arg, &query, sizeof(query)))
+                                retval = -EFAULT;
+                        else
+                                retval = 0;
+                }
+                kvfree(buckets);
+                return retval;
+
+        case SIMTEMP_IOC_GET_WINDOW:
+                window_read(simtemp_dev->window, &window);
+                if (copy_to_user(user_arg, &window, sizeof(window)))
+                        return -EFAULT;
+                return 0;
+
+        case SIMTEMP_IOC_READ_ALARMS:
+                if (copy_from_user(&alarm_read, user_arg, sizeof(alarm_read)))
+                        return -EFAULT;
+
+                alarm_read.count = min_t(u32, alarm_read.count, ALARM_EVENTS);
+                events = kmalloc_array(alarm_read.count, sizeof(struct simtemp_alarm_event),
+                                       GFP_KERNEL);
+                if (!events)
+                        return -ENOMEM;
+
+                /* Copied out under the alarms lock, so to userspace after.
+                 * Events that fail to copy are still consumed */
+                alarm_read.count = alarms_read(simtemp_dev->alarms, &dev_handle->alarm_seq,
+                                               alarm_read.count, events, &alarm_read.lost);
+                retval = 0;
+                if (copy_to_user(u64_to_user_ptr(alarm_read.events), events,
+                                 alarm_read.count * sizeof(struct simtemp_alarm_event)) ||
+                    copy_to_user(user_arg, &alarm_read, sizeof(alarm_read)))
+                        retval = -EFAULT;
+                kfree(events);
+                return retval;
+
+        case SIMTEMP_IOC_GET_STREAM:
+                stream.next_seq = READ_ONCE(dev_handle->consumed_seq) + 1;
+                stream.lost = dev_handle->lost;
+                if (copy_to_user(user_arg, &stream, sizeof(stream)))
+                        return -EFAULT;
+                return 0;
+
+        default:
+                return -ENOTTY;
+        }
+}
+
 static int nxp_simtemp_release(struct inode *inode, struct file *file)
 {
         struct nxp_simtemp_dev_handle *dev_handle = 
                         (struct nxp_simtemp_dev_handle *)file->private_data;
-        
-        /* Remove process from consumer list */
-        spin_lock_bh(&simtemp_dev.consumers_lock);
-        list_del(&dev_handle->node);
-        spin_unlock_bh(&simtemp_dev.consumers_lock);
+        nxp_simtemp_dev_t *simtemp_dev = dev_handle->simtemp_dev;
+
+        /* And the last one parks it */
+        mutex_lock(&simtemp_dev->producer_lock);
+        simtemp_dev->consumers--;
+        if (simtemp_dev->producer_running && !producer_wanted(simtemp_dev))
+                stop_producer(simtemp_dev);
+        mutex_unlock(&simtemp_dev->producer_lock);
 
         kfree(dev_handle);
 
@@ -382,101 +924,263 @@ static int nxp_simtemp_release(struct inode *inode, struct file *file)
         return 0;
 }
 
+/**
+ * Override the default configuration with the properties of the device node,
+ * if any. Invalid values are ignored, the defaults are kept for them.
+ * @param simtemp_dev[in,out] Instance being probed
+ * @param dev[in] Platform device of the instance
+ */
+static void read_dt_params(nxp_simtemp_dev_t *simtemp_dev, struct device *dev)
+{
+        struct simtemp_params *params = &simtemp_dev->params;
+        u32 sampling_ms, threshold, hysteresis;
+
+        if (!device_property_read_u32(dev, "sampling-ms", &sampling_ms)) {
+                if (sampling_ms > 0)
+                        params->sampling_us = (u64)sampling_ms * USEC_PER_MSEC;
+                else
+                        dev_warn(dev, "Ignoring invalid sampling-ms\n");
+        }
+
+        if (device_property_read_u32(dev, "threshold_mC", &threshold))
+                threshold = params->threshold_mC;
+        if (device_property_read_u32(dev, "hysteresis_mC", &hysteresis))
+                hysteresis = params->hysteresis_mC;
+
+        /* Same constraints as the sysfs attributes */
+        if (((s32)threshold >= MIN_TEMP) && ((s32)threshold <= MAX_TEMP) &&
+            (hysteresis <= (MAX_TEMP - MIN_TEMP)) &&
+            (((s32)threshold - (s32)hysteresis) >= MIN_TEMP)) {
+                params->threshold_mC = threshold;
+                params->hysteresis_mC = hysteresis;
+        } else {
+                dev_warn(dev, "Ignoring invalid threshold_mC/hysteresis_mC\n");
+        }
+}
+
 static int nxp_simtemp_probe(struct platform_device *pdev)
 {
+        nxp_simtemp_dev_t *simtemp_dev;
+        int minor;
         int retval;
 
+        simtemp_dev = kzalloc(sizeof(nxp_simtemp_dev_t), GFP_KERNEL);
+        if (!simtemp_dev) {
+                retval = -ENOMEM;
+                goto finish;
+        }
+
+        /* Each instance takes the lowest free minor as its id */
+        minor = ida_alloc_max(&simtemp_minors, NXP_SIMTEMP_MINOR_COUNT - 1, GFP_KERNEL);
+        if (minor < 0) {
+                pr_err("No device numbers left\n");
+                retval = minor;
+                goto free_device_struct;
+        }
+        simtemp_dev->devnum = MKDEV(MAJOR(simtemp_devnum), minor);
+
         /* First init all static fields of the device struct */
-        simtemp_dev.in_threshold = false;
-        spin_lock_init(&simtemp_dev.consumers_lock);
-        INIT_LIST_HEAD(&simtemp_dev.consumers);
+        simtemp_dev->in_threshold = false;
+        init_params(&simtemp_dev->params);
+        read_dt_params(simtemp_dev, &pdev->dev);
+        init_gen_state(&simtemp_dev->gen, &simtemp_dev->params);
+        init_waitqueue_head(&simtemp_dev->wq);
+        atomic64_set(&simtemp_dev->wake_target, S64_MAX);
+        atomic64_set(&simtemp_dev->wake_deadline, S64_MAX);
+        init_timer(simtemp_dev);
 
         /* Init all dynamic elements of the device struct */
-        cdev_init(&simtemp_dev.cdev, &nxp_simtemp_fops);
-        simtemp_dev.cdev.owner = THIS_MODULE;
-
-        /* Get available device number */
-        retval = alloc_chrdev_region(&simtemp_dev.devnum,
-                                     0,
-                                     NXP_SIMTEMP_MINOR_COUNT,
-                                     NXP_SIMTEMP_DRIVER_NAME);
-        if (retval) {
-                pr_err("Failed to allocate device numbers\n");
-                goto finish;
+        cdev_init(&simtemp_dev->cdev, &nxp_simtemp_fops);
+        simtemp_dev->cdev.owner = THIS_MODULE;
+
+        simtemp_dev->stats = alloc_percpu(struct simtemp_stats);
+        if (!simtemp_dev->stats) {
+                pr_err("Failed to allocate statistics\n");
+                retval = -ENOMEM;
+                goto free_minor;
         }
 
         /* Ring buffer needs to be available before cdev is exposed */
-        retval = init_ring_buffer();
-        if (retval) {
+        simtemp_dev->ring = init_ring_buffer();
+        if (!simtemp_dev->ring) {
                 pr_err("Failed to create ring buffer\n");
-                goto free_chrdev_region;
+                retval = -ENOMEM;
+                goto free_stats;
         }
 
+        simtemp_dev->rollup = init_rollup();
+        if (!simtemp_dev->rollup) {
+                pr_err("Failed to create rollup\n");
+                retval = -ENOMEM;
+                goto free_ring_buffer;
+        }
+
+        simtemp_dev->window = init_window(WINDOW_SIZE_DEFAULT);
+        if (!simtemp_dev->window) {
+                pr_err("Failed to create window\n");
+                retval = -ENOMEM;
+                goto free_rollup;
+        }
+
+        simtemp_dev->alarms = init_alarms();
+        if (!simtemp_dev->alarms) {
+                pr_err("Failed to create alarms\n");
+                retval = -ENOMEM;
+                goto free_window;
+        }
+
+        simtemp_dev->replay = init_replay();
+        if (!simtemp_dev->replay) {
+                pr_err("Failed to create replay\n");
+                retval = -ENOMEM;
+                goto free_alarms;
+        }
+        simtemp_dev->gen.replay = simtemp_dev->replay;
+
         /* Expose char device to the system */
-        retval = cdev_add(&simtemp_dev.cdev,
-                          simtemp_dev.devnum,
-                          NXP_SIMTEMP_MINOR_COUNT);
+        retval = cdev_add(&simtemp_dev->cdev, simtemp_dev->devnum, 1);
         if (retval) {
                 pr_err("Failed to add char device\n");
-                goto free_ring_buffer;
+                goto free_replay;
         }
 
-        /* Create a /dev node */
-        simtemp_dev.device = device_create(&nxp_simtemp_class,
-                                           &pdev->dev,
-                                           simtemp_dev.devnum,
-                                           NULL,
-                                           NXP_SIMTEMP_DEVICE_NAME);
-        if (IS_ERR(simtemp_dev.device)) {
+        /* Create a /dev node, the sysfs attributes find the instance
+         * through the drvdata */
+        simtemp_dev->device = device_create(&nxp_simtemp_class,
+                                            &pdev->dev,
+                                            simtemp_dev->devnum,
+                                            simtemp_dev,
+                                            NXP_SIMTEMP_NODE_NAME,
+                                            minor);
+        if (IS_ERR(simtemp_dev->device)) {
                 pr_err("Failed to create device\n");
-                retval = -PTR_ERR(simtemp_dev.device);
+                retval = PTR_ERR(simtemp_dev->device);
                 goto unregister_cdev;
         }
 
-        /* Init producer after everything is in place */
-        retval = init_timer();
+        platform_set_drvdata(pdev, simtemp_dev);
+
+        /* Histograms must be there before the producer records into them */
+        retval = add_debugfs_instance(simtemp_dev);
         if (retval) {
-                pr_err("Failed to create workqueue\n");
+                pr_err("Failed to create histograms\n");
                 goto free_device;
         }
 
-        pr_info("Probe success!\n");
+        /* Start producer after everything is in place */
+        enable_producer(simtemp_dev);
+
+        pr_info("Probe success for " NXP_SIMTEMP_NODE_NAME "!\n", minor);
         return 0;
 
 free_device:
-        device_destroy(&nxp_simtemp_class, simtemp_dev.devnum); 
+        device_destroy(&nxp_simtemp_class, simtemp_dev->devnum); 
 unregister_cdev:
-        cdev_del(&simtemp_dev.cdev);
+        cdev_del(&simtemp_dev->cdev);
+free_replay:
+        destroy_replay(simtemp_dev->replay);
+free_alarms:
+        destroy_alarms(simtemp_dev->alarms);
+free_window:
+        destroy_window(simtemp_dev->window);
+free_rollup:
+        destroy_rollup(simtemp_dev->rollup);
 free_ring_buffer:
-        destroy_ring_buffer();
-free_chrdev_region:
-        unregister_chrdev_region(simtemp_dev.devnum, NXP_SIMTEMP_MINOR_COUNT);
+        destroy_ring_buffer(simtemp_dev->ring);
+free_stats:
+        free_percpu(simtemp_dev->stats);
+free_minor:
+        ida_free(&simtemp_minors, minor);
+free_device_struct:
+        kfree(simtemp_dev);
 finish:
         return retval;
 }
 
 static void nxp_simtemp_remove_new(struct platform_device *pdev)
 {
+        nxp_simtemp_dev_t *simtemp_dev = platform_get_drvdata(pdev);
+
         /* First cancel the producer */
-        free_timer();
-        device_destroy(&nxp_simtemp_class, simtemp_dev.devnum);
-        cdev_del(&simtemp_dev.cdev);
+        free_timer(simtemp_dev);
+        remove_debugfs_instance(simtemp_dev);
+        device_destroy(&nxp_simtemp_class, simtemp_dev->devnum);
+        cdev_del(&simtemp_dev->cdev);
         /* Now that nobody needs to use the buffer, free it */
-        destroy_ring_buffer();
-        unregister_chrdev_region(simtemp_dev.devnum, NXP_SIMTEMP_MINOR_COUNT);
+        destroy_ring_buffer(simtemp_dev->ring);
+        destroy_rollup(simtemp_dev->rollup);
+        destroy_window(simtemp_dev->window);
+        destroy_alarms(simtemp_dev->alarms);
+        destroy_replay(simtemp_dev->replay);
+        free_percpu(simtemp_dev->stats);
+        ida_free(&simtemp_minors, MINOR(simtemp_dev->devnum));
+        kfree(simtemp_dev);
         pr_info("Device removed\n");
 }
 
+#ifndef USE_DTS
+static void unregister_instances(unsigned int count)
+{
+        while (count--)
+                platform_device_unregister(simtemp_pdevs[count]);
+
+        kfree(simtemp_pdevs);
+}
+
+static int register_instances(void)
+{
+        unsigned int i;
+        int retval;
+
+        if ((0 == instances) || (instances > NXP_SIMTEMP_MINOR_COUNT)) {
+                pr_err("instances must be within [1, %d]\n", NXP_SIMTEMP_MINOR_COUNT);
+                return -EINVAL;
+        }
+
+        simtemp_pdevs = kcalloc(instances, sizeof(struct platform_device *), GFP_KERNEL);
+        if (!simtemp_pdevs)
+                return -ENOMEM;
+
+        for (i = 0; i < instances; i++) {
+                simtemp_pdevs[i] = platform_device_register_simple(NXP_SIMTEMP_DEVICE_NAME,
+                                                                   i,
+                                                                   NULL,
+                                                                   0);
+                if (IS_ERR(simtemp_pdevs[i])) {
+                        retval = PTR_ERR(simtemp_pdevs[i]);
+                        pr_err("Failure registering device %u\n", i);
+                        unregister_instances(i);
+                        return retval;
+                }
+        }
+
+        return 0;
+}
+#endif
+
 static int __init nxp_simtemp_init(void)
 {
         int retval;
 
+        /* Device numbers for all the instances there can be */
+        retval = alloc_chrdev_region(&simtemp_devnum,
+                                     0,
+                                     NXP_SIMTEMP_MINOR_COUNT,
+                                     NXP_SIMTEMP_DRIVER_NAME);
+        if (retval) {
+                pr_err("Failed to allocate device numbers\n");
+                goto finish;
+        }
+
+        init_generator_groups();
         retval = class_register(&nxp_simtemp_class);
         if (retval) {
                 pr_err("Failed to create class\n");
-                goto finish;
+                goto free_chrdev_region;
         }
 
+        init_debugfs();
+
         retval = platform_driver_register(&nxp_simtemp_driver);
         if (retval) {
                 pr_err("Failed to register driver\n");
@@ -484,23 +1188,23 @@ static int __init nxp_simtemp_init(void)
         }
 
 #ifndef USE_DTS
-        simtemp_pdev = platform_device_register_simple(NXP_SIMTEMP_DEVICE_NAME,
-                                                       -1,
-                                                       NULL,
-                                                       0);
-        if (IS_ERR(simtemp_pdev)) {
-                pr_err("Failure registering device\n");
+        retval = register_instances();
+        if (retval)
                 goto unregister_driver;
-        }
 #endif
 
         pr_info("Module loaded successfully!\n");
         return 0;
 
+#ifndef USE_DTS
 unregister_driver:
         platform_driver_unregister(&nxp_simtemp_driver);
+#endif
 unregister_class:
+        destroy_debugfs();
         class_unregister(&nxp_simtemp_class);
+free_chrdev_region:
+        unregister_chrdev_region(simtemp_devnum, NXP_SIMTEMP_MINOR_COUNT);
 finish:
         return retval;
 }
@@ -509,10 +1213,13 @@ module_init(nxp_simtemp_init);
 static void __exit nxp_simtemp_exit(void)
 {
 #ifndef USE_DTS
-        platform_device_unregister(simtemp_pdev);
+        unregister_instances(instances);
 #endif
         platform_driver_unregister(&nxp_simtemp_driver);
+        destroy_debugfs();
         class_unregister(&nxp_simtemp_class);
+        unregister_chrdev_region(simtemp_devnum, NXP_SIMTEMP_MINOR_COUNT);
+        ida_destroy(&simtemp_minors);
         pr_info("Goodbye!\n");
 }
 module_exit(nxp_simtemp_exit);
@@ -0,0 +1,91 @@
+#ifndef NXP_SIMTEMP_CORE_H
+#define NXP_SIMTEMP_CORE_H
+
+#include <linux/types.h>
+#include <linux/cdev.h>
+#include <linux/wait.h>
+#include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/atomic.h>
+
+#include "nxp_simtemp_sysfs.h"
+#include "nxp_simtemp_generators.h"
+#include "nxp_simtemp_debugfs.h"
+
+struct lifo_ring_buffer;
+struct simtemp_rollup;
+struct sliding_window;
+struct simtemp_alarms;
+struct simtemp_replay;
+
+/**
+ * Struct containing the objects and state pertaining to one simulated sensor.
+ * One is allocated per platform device, and set as the drvdata of both the
+ * platform device and the class device, which the sysfs attributes use.
+ */
+typedef struct nxp_simtemp_device {
+        dev_t devnum;          /* Device number of this instance */
+        struct device *device; /* Device instance in /dev */
+        struct cdev cdev;      /* The char device struct for fops */
+        bool in_threshold;     /* Temp threshold state */
+
+        struct simtemp_params params;  /* Configuration, owned by sysfs */
+        struct simtemp_gen_state gen;  /* Generator state, producer only */
+        struct lifo_ring_buffer *ring; /* Sample history */
+        struct simtemp_rollup *rollup; /* Downsampled history */
+        struct sliding_window *window; /* Aggregates of the last samples */
+        struct simtemp_alarms *alarms; /* Alarm table and event queue */
+        struct simtemp_replay *replay; /* Trace of the replay mode */
+        wait_queue_head_t wq;          /* Consumers waiting for a sample */
+
+        /* Lowest published count and monotonic time any waiter wants to be
+         * woken up at, S64_MAX when nobody is waiting. Reset on wakeup,
+         * waiters that aren't done yet register again */
+        atomic64_t wake_target;
+        atomic64_t wake_deadline;
+        u64 threshold_seq; /* Published count of the latest threshold transition */
+
+        struct timer_list tmr;
+        struct hrtimer hrtmr;
+        struct task_struct *producer_task; /* Only while the kthread runs */
+
+        /* Serializes producer start/stop, the backend that is currently
+         * running may differ from the configured one while a switch is in
+         * progress */
+        struct mutex producer_lock;
+        enum simtemp_producer_mode active_producer;
+        bool producer_enabled;  /* Set once probed, until removed */
+        bool producer_running;  /* False while parked, see `ondemand` */
+        unsigned int consumers; /* Open handles, under producer_lock */
+
+        /* Absolute tick schedule, only touched by the producer and when
+         * starting it */
+        ktime_t tick_epoch;
+        u64 tick_period_ns;
+        u64 tick_count;
+
+        /* Runtime counters, written by the producer only */
+        u64 missed_ticks;
+        u64 late_ticks;
+
+        struct simtemp_stats __percpu *stats;
+
+        /* Latency histograms, shown in debugfs */
+        struct simtemp_hist __percpu *tick_jitter;      /* Tick vs deadline */
+        struct simtemp_hist __percpu *delivery_latency; /* Push to copy_to_user */
+        u64 last_push_ns; /* Monotonic time of the latest tick's push */
+        struct dentry *debugfs_dir;
+} nxp_simtemp_dev_t;
+
+/* Statistics are per CPU, counting is a single this_cpu op */
+#define STAT_INC(simtemp_dev, stat) \
+        this_cpu_inc((simtemp_dev)->stats->count[simtemp_stat_##stat])
+#define STAT_ADD(simtemp_dev, stat, val) \
+        this_cpu_add((simtemp_dev)->stats->count[simtemp_stat_##stat], (val))
+
+void restart_producer(nxp_simtemp_dev_t *simtemp_dev);
+void reseed_producer(nxp_simtemp_dev_t *simtemp_dev, u64 seed);
+
+#endif
@@ -0,0 +1,117 @@
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/device.h>
+#include <linux/percpu.h>
+#include <linux/math64.h>
+
+#include "nxp_simtemp_debugfs.h"
+#include "nxp_simtemp_core.h"
+
+#define NXP_SIMTEMP_DEBUGFS_DIR "nxp_simtemp"
+
+/* Percentiles shown in the summary, in per mille */
+static const u32 hist_percentiles[] = { 500, 990, 999 };
+/* Must be in the same order as hist_percentiles */
+static const char *hist_percentile_names[] = { "p50", "p99", "p999" };
+
+/* Parent of the per instance directories */
+static struct dentry *simtemp_debugfs_root;
+
+/**
+ * Upper bound of a histogram bucket
+ * @return u64 - Largest value counted into the bucket, in ns
+ */
+static inline u64 bucket_limit(unsigned int bucket)
+{
+        return (bucket < 64) ? (1ULL << bucket) - 1 : U64_MAX;
+}
+
+/**
+ * Print a histogram: the percentile summary, then every non-empty bucket.
+ * Percentiles are the upper bound of the bucket they fall in, so they are
+ * accurate within a factor of 2.
+ */
+static int hist_show(struct seq_file *s, void *unused)
+{
+        struct simtemp_hist __percpu *hist = s->private;
+        u64 buckets[SIMTEMP_HIST_BUCKETS] = { 0 };
+        u64 total = 0, cumulative, target;
+        unsigned int i, p;
+        int cpu;
+
+        for_each_possible_cpu(cpu) {
+                for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++)
+                        buckets[i] += per_cpu_ptr(hist, cpu)->bucket[i];
+        }
+
+        for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++)
+                total += buckets[i];
+
+        seq_printf(s, "count: %llu\n", total);
+
+        for (p = 0; p < ARRAY_SIZE(hist_percentiles); p++) {
+                if (0 == total) {
+                        seq_printf(s, "%s: -\n", hist_percentile_names[p]);
+                        continue;
+                }
+
+                /* Rank of the percentile, rounded up */
+                target = div_u64(total * hist_percentiles[p] + 999, 1000);
+                cumulative = 0;
+                for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++) {
+                        cumulative += buckets[i];
+                        if (cumulative >= target)
+                                break;
+                }
+                seq_printf(s, "%s: <= %llu ns\n", hist_percentile_names[p], bucket_limit(i));
+        }
+
+        seq_puts(s, "\n");
+        for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++) {
+                if (buckets[i])
+                        seq_printf(s, "<= %20llu ns: %llu\n", bucket_limit(i), buckets[i]);
+        }
+
+        return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(hist);
+
+void init_debugfs(void)
+{
+        /* debugfs is optional, failing to create it is not an error */
+        simtemp_debugfs_root = debugfs_create_dir(NXP_SIMTEMP_DEBUGFS_DIR, NULL);
+}
+
+void destroy_debugfs(void)
+{
+        debugfs_remove_recursive(simtemp_debugfs_root);
+}
+
+int add_debugfs_instance(nxp_simtemp_dev_t *simtemp_dev)
+{
+        /* The histograms are always recorded, only their files are optional */
+        simtemp_dev->tick_jitter = alloc_percpu(struct simtemp_hist);
+        simtemp_dev->delivery_latency = alloc_percpu(struct simtemp_hist);
+        if (!simtemp_dev->tick_jitter || !simtemp_dev->delivery_latency) {
+                free_percpu(simtemp_dev->tick_jitter);
+                free_percpu(simtemp_dev->delivery_latency);
+                return -ENOMEM;
+        }
+
+        simtemp_dev->debugfs_dir = debugfs_create_dir(dev_name(simtemp_dev->device),
+                                                      simtemp_debugfs_root);
+        debugfs_create_file("tick_jitter", 0444, simtemp_dev->debugfs_dir,
+                            (void __force *)simtemp_dev->tick_jitter, &hist_fops);
+        debugfs_create_file("delivery_latency", 0444, simtemp_dev->debugfs_dir,
+                            (void __force *)simtemp_dev->delivery_latency, &hist_fops);
+
+        return 0;
+}
+
+void remove_debugfs_instance(nxp_simtemp_dev_t *simtemp_dev)
+{
+        /* Files first, so nobody is left reading the histograms */
+        debugfs_remove_recursive(simtemp_dev->debugfs_dir);
+        free_percpu(simtemp_dev->tick_jitter);
+        free_percpu(simtemp_dev->delivery_latency);
+}
@@ -0,0 +1,33 @@
+#ifndef NXP_SIMTEMP_DEBUGFS_H
+#define NXP_SIMTEMP_DEBUGFS_H
+
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/bitops.h>
+
+struct nxp_simtemp_device;
+
+/* Bucket i holds the values in [2^(i-1), 2^i), bucket 0 holds 0 */
+#define SIMTEMP_HIST_BUCKETS 65
+
+/* Latency histogram in ns, kept per CPU like the statistics */
+struct simtemp_hist {
+    u64 bucket[SIMTEMP_HIST_BUCKETS];
+};
+
+/**
+ * Count a value into a histogram, safe from any context.
+ * @param[in] hist Per CPU histogram
+ * @param[in] ns Value to count, in ns
+ */
+static inline void hist_record(struct simtemp_hist __percpu *hist, u64 ns)
+{
+    this_cpu_inc(hist->bucket[fls64(ns)]);
+}
+
+void init_debugfs(void);
+void destroy_debugfs(void);
+int add_debugfs_instance(struct nxp_simtemp_device *simtemp_dev);
+void remove_debugfs_instance(struct nxp_simtemp_device *simtemp_dev);
+
+#endif
@@ -1,198 +1,599 @@
 #include <linux/ktime.h>
 #include <linux/random.h>
+#include <linux/math64.h>
+#include <linux/bitops.h>
+#include <linux/minmax.h>
+#include <linux/stddef.h>
+#include <linux/time64.h>
+#include <linux/fixp-arith.h>
 
 #include "nxp_simtemp.h"
 #include "nxp_simtemp_generators.h"
+#include "nxp_simtemp_replay.h"
 
-/* Value noise for the normal generator courtesy of Gemini AI, with fine-tuning by me */
-/* See docs/AI_NOTES.md for prompt details */
-
-/********************* START OF AUTOGENERATED SECTION *************************/
-/* Generated by noise_table_gen.py. DO NOT EDIT MANUALLY */
-/* Generated on: 2025-11-06 01:43:08 */
-#define NOISE_TABLE_SIZE 256
-#define NOISE_VALUE_EXP 24
-
-const s32 VALUE_TABLE[NOISE_TABLE_SIZE] = {
-    453194,     457587,     484984,     549775,     658194,     809674,     998209,     1213714,
-    1443383,     1673052,     1888557,     2077092,     2228572,     2336991,     2401782,     2429179,
-    2433572,     2453599,     2578496,     2873871,     3368138,     4058713,     4918217,     5900672,
-    6947702,     7994731,     8977186,     9836690,     10527265,     11021532,     11316907,     11441804,
-    11461831,     11455427,     11415486,     11321030,     11162971,     10942135,     10667278,     10353103,
-    10018278,     9683454,     9369279,     9094422,     8873586,     8715527,     8621071,     8581130,
-    8574726,     8582446,     8630589,     8744446,     8934969,     9201162,     9532471,     9911174,
-    10314768,     10718362,     11097065,     11428374,     11694567,     11885090,     11998947,     12047090,
-    12054810,     12032592,     11894033,     11566347,     11018014,     10251898,     9298374,     8208451,
-    7046888,     5885325,     4795402,     3841878,     3075762,     2527429,     2199743,     2061184,
-    2038966,     2046992,     2097044,     2215415,     2413491,     2690238,     3034682,     3428399,
-    3847994,     4267590,     4661307,     5005751,     5282498,     5480574,     5598945,     5648997,
-    5657023,     5670134,     5751902,     5945279,     6268867,     6720974,     7283676,     7926872,
-    8612344,     9297817,     9941013,     10503715,     10955822,     11279410,     11472787,     11554555,
-    11567666,     11544646,     11401085,     11061569,     10493440,     9699666,     8711719,     7582448,
-    6378951,     5175454,     4046183,     3058236,     2264462,     1696333,     1356817,     1213256,
-    1190236,     1210125,     1334160,     1627497,     2118353,     2804164,     3657737,     4633413,
-    5673218,     6713023,     7688699,     8542272,     9228083,     9718939,     10012276,     10136311,
-    10156200,     10149020,     10104240,     9998338,     9821127,     9573532,     9265371,     8913128,
-    8537732,     8162336,     7810093,     7501932,     7254337,     7077126,     6971224,     6926444,
-    6919264,     6918575,     6914275,     6904107,     6887093,     6863321,     6833734,     6799915,
-    6763872,     6727830,     6694011,     6664424,     6640652,     6623638,     6613470,     6609170,
-    6608481,     6605294,     6585418,     6538412,     6459754,     6349856,     6213075,     6056727,
-    5890103,     5723479,     5567131,     5430350,     5320452,     5241794,     5194788,     5174912,
-    5171725,     5186468,     5278410,     5495848,     5859700,     6368062,     7000781,     7724009,
-    8494773,     9265537,     9988765,     10621484,     11129846,     11493698,     11711136,     11803078,
-    11817821,     11799262,     11683517,     11409788,     10951742,     10311774,     9515256,     8604797,
-    7634496,     6664195,     5753736,     4957218,     4317250,     3859204,     3585475,     3469730,
-    3451171,     3475290,     3625707,     3981435,     4576695,     5408373,     6443497,     7626695,
-    8887662,     10148629,     11331827,     12366951,     13198629,     13793889,     14149617,     14300034,
-    14324153,     14293384,     14101493,     13647680,     12888292,     11827297,     10506761,     8997324,
-    7388674,     5780023,     4270586,     2950050,     1889055,     1129667,     675854,     483963
-};
-/********************** END OF AUTOGENERATED SECTION **************************/
-#define NOISE_TABLE_MASK (NOISE_TABLE_SIZE - 1)
-struct noise_state {
-    u64 current_position;
-    u32 x_factor;
-};
+/* Control points of the value noise, the table interpolates between them */
+#define NOISE_POINT_SHIFT  4  /* log2(table entries per point) */
+#define NOISE_POINTS       (NOISE_TABLE_SIZE >> NOISE_POINT_SHIFT)
+/* 1 / (sum of the octave weights 1, 1/2, ... 1/2^(n-1)), in Q16. Computed by
+ * the compiler, so summing the octaves needs no division */
+#define OCTAVE_NORM(n) (u32)((1ULL << ((n) - 1 + 16)) / ((1ULL << (n)) - 1))
 
-struct noise_state state = {
-        .current_position = 0,
-        .x_factor = 0x7000FFFF,
+/* Describes an s32 field of struct simtemp_params for the sysfs directory
+ * of a generator */
+#define GEN_PARAM(_name, field, _min, _max, _def)                              \
+        {                                                                      \
+                .name = _name,                                                 \
+                .offset = offsetof(struct simtemp_params, field),              \
+                .min = _min,                                                   \
+                .max = _max,                                                   \
+                .def = _def,                                                   \
+        }
+
+static const u32 octave_norm[NOISE_OCTAVES_MAX + 1] = {
+        [1] = OCTAVE_NORM(1), [2] = OCTAVE_NORM(2), [3] = OCTAVE_NORM(3),
+        [4] = OCTAVE_NORM(4), [5] = OCTAVE_NORM(5), [6] = OCTAVE_NORM(6),
+        [7] = OCTAVE_NORM(7), [8] = OCTAVE_NORM(8)
 };
 
+/* Perlin's smootherstep 6t^5 - 15t^4 + 10t^3 of a Q16 t in [0, 1], in Q16 */
+static u32 smootherstep(u32 t)
+{
+        s64 x = t;
+        s64 poly = ((x * ((x * 6) - (15 << 16))) >> 16) + (10 << 16);
+
+        return (u32)((((x * x) >> 16) * ((x * poly) >> 16)) >> 16);
+}
+
+static void normal_init(const struct simtemp_params *params,
+                        struct simtemp_gen_state *state)
+{
+        state->current_position = 0;
+}
+
+static s32 normal_generator(const struct simtemp_params *params,
+                            struct simtemp_gen_state *state)
+{
+        unsigned int octaves = params->noise_octaves;
+        unsigned int k;
+        u64 sum;
+        u32 value;
+
+        state->current_position += params->noise_speed;
+        value = noise_at(state->noise_table, state->current_position);
+
+        /* Fractal noise: each octave runs twice as fast as the previous one,
+         * with half its weight. The golden ratio offset keeps octaves from
+         * lining up on the same table entries */
+        if (octaves > 1) {
+                sum = value;
+                for (k = 1; k < octaves; k++)
+                        sum += (u64)noise_at(state->noise_table,
+                                             (state->current_position << k) +
+                                             k * 0x9E3779B97F4A7C15ULL) >> k;
+
+                /* Back to [0, 2^NOISE_VALUE_EXP], rounding may overshoot */
+                value = min_t(u64, (sum * octave_norm[octaves]) >> 16,
+                              1 << NOISE_VALUE_EXP);
+        }
+
+        /* Centered in the supported range, amplitude_mC peak to peak */
+        return (MIN_TEMP + MAX_TEMP) / 2 - (s32)(params->noise_amplitude_mC / 2) +
+               (s32)(((u64)value * params->noise_amplitude_mC) >> NOISE_VALUE_EXP);
+}
+
 /**
- * s32_lerp_scaled - Linearly interpolate between signed start and stop values 
- * using a factor t scaled by tmax.
- * @start: The signed start value (A).
- * @stop: The signed end value (B).
- * @tmax: The maximum value t can take (u32, defines the scale factor).
- * @t: The current interpolation factor (u32, 0 <= t <= tmax).
- *
- * The calculation is equivalent to: (start * (tmax - t) + stop * t) / tmax.
- * Uses 64-bit intermediate storage (s64) to safely handle signed multiplication 
- * and prevent overflow.
- *
- * Returns: The interpolated s32 value.
- * Courtesy of Gemini AI
+ * xoshiro128** by Blackman and Vigna: 128 bits of state, a few shifts and
+ * rotates per output, good enough statistics for a noise source. Not
+ * cryptographic, which a simulated sensor doesn't need.
+ * @param[in,out] s Generator state, never all zero
+ * @return u32 - Next output
  */
-static inline s32 lerp(s32 start, s32 stop, u32 tmax, u32 t)
+static u32 xoshiro128ss(u32 s[4])
 {
-    s64 a_term, b_term, result;
-    u32 t_inv; // Represents (tmax - t)
+        const u32 result = rol32(s[1] * 5, 7) * 9;
+        const u32 t = s[1] << 9;
 
-    // Handle edge cases for efficiency
-    if (t == 0 || tmax == 0)
-        return start;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rol32(s[3], 11);
 
-    if (t >= tmax)
-        return stop;
+        return result;
+}
 
-    // 1. Calculate the inverse factor: (tmax - t)
-    t_inv = tmax - t;
+/**
+ * Random number from the source selected by `rng`
+ * @param[in] params Configuration of the instance
+ * @param[in,out] state Generator state, for xoshiro
+ * @param[in] range Number of values, above 0
+ * @return u32 - Random in [0, range)
+ */
+static u32 gen_random(const struct simtemp_params *params,
+                      struct simtemp_gen_state *state, u32 range)
+{
+        if (simtemp_rng_csprng == params->rng)
+                return get_random_u32_below(range);
 
-    // 2. Calculate the start term: start * (tmax - t)
-    // Cast BOTH 'start' (s32) and 't_inv' (u32) to s64 before multiplication.
-    // Casting 't_inv' to s64 ensures the entire multiplication result is signed.
-    a_term = (s64)start * (s64)t_inv;
+        /* Scaled by a multiply and shift instead of a modulo. The bias is
+         * below range / 2^32, about 4e-5 for the whole supported range */
+        return (u32)(((u64)xoshiro128ss(state->prng) * range) >> 32);
+}
 
-    // 3. Calculate the stop term: stop * t
-    b_term = (s64)stop * (s64)t;
+static s32 noisy_generator(const struct simtemp_params *params,
+                           struct simtemp_gen_state *state)
+{
+        /* Random in the supported range, + 1 for inclusive ceil */
+        const u32 range = MAX_TEMP - MIN_TEMP + 1;
 
-    // 4. Sum the terms
-    // The sum is guaranteed to fit within s64 (approx. 2*2^63 max).
-    result = a_term + b_term;
+        return (s32)((s64)gen_random(params, state, range) + (s64)MIN_TEMP);
+}
 
-    // 5. Divide by tmax (restores the s32 integer value)
-    // The division must be performed using the signed 64-bit result.
-    // The divisor tmax (u32) is safely promoted to s64 for the division.
-    return (s32)(result / tmax);
+static void ramp_init(const struct simtemp_params *params,
+                      struct simtemp_gen_state *state)
+{
+        state->elapsed_us = 0;
 }
 
-static s32 normal_generator(void)
+static s32 ramp_generator(const struct simtemp_params *params,
+                          struct simtemp_gen_state *state)
 {
-        const s32 result_range = MAX_TEMP - MIN_TEMP;
+        u64 period_us = (u64)params->ramp_period_ms * USEC_PER_MSEC;
+        u64 rise;
 
-        u32 x_int;
-        u32 x_frac;
-        s32 val0, val1;
-        s32 scaled_result;
+        state->elapsed_us += params->sampling_us;
+        if (state->elapsed_us >= period_us) {
+                state->elapsed_us = 0;
+        }
 
-        // 1. Calculate the current fractional and integer parts of the position.
-        // The current_position is an accumulating counter.
-        state.current_position += state.x_factor;
+        /* A linear interpolation, but the period in us doesn't fit in a
+         * power of 2. The range fits in 18 bits and elapsed_us in 42, so no
+         * overflow */
+        rise = div64_u64((u64)(params->ramp_max - params->ramp_min) * state->elapsed_us,
+                         period_us);
+        return params->ramp_min + (s32)rise;
+}
 
-        // x_int: Integer part (used for table indexing).
-        // The current_position is treated as Q32.32 (32 integer bits, 32 fractional bits).
-        x_int = (state.current_position >> 32); 
+/**
+ * Move a time into a period forward by a sampling interval, wrapping around
+ * the period without a division
+ * @return u64 - New time into the period
+ */
+static u64 advance_in_period(u64 elapsed_us, u64 sampling_us, u64 period_us)
+{
+        elapsed_us += sampling_us;
+        if (elapsed_us >= period_us)
+                elapsed_us -= period_us;
+        /* Sampling slower than the period, only the phase matters */
+        if (elapsed_us >= period_us)
+                elapsed_us = 0;
 
-        // x_frac: Fractional part (used for interpolation factor t).
-        x_frac = (u32)state.current_position; 
+        return elapsed_us;
+}
 
-        // 2. Determine the two surrounding integer points (i0, i1)
-        // The base index i0 is hashed with the random seed to break the pattern.
-        u32 i0 = (x_int) & NOISE_TABLE_MASK;
-        u32 i1 = (i0 + 1) & NOISE_TABLE_MASK;
+static void sine_init(const struct simtemp_params *params,
+                      struct simtemp_gen_state *state)
+{
+        state->sine.phase = 0;
+        state->sine.step = 0;
+        state->sine.step_period_us = 0;
+        state->sine.step_sampling_us = 0;
+}
 
-        // 3. Look up the values at the surrounding points.
-        val0 = VALUE_TABLE[i0];
-        val1 = VALUE_TABLE[i1];
+/**
+ * Recompute the phase increment per sample, only when the period or the
+ * sampling changed since the last sample, so the common case has no division
+ */
+static void sine_update_step(const struct simtemp_params *params,
+                             struct simtemp_gen_state *state)
+{
+        u64 period_us = (u64)params->sine_period_ms * USEC_PER_MSEC;
+        u64 rem_us;
 
-        // 4. Interpolate between the two values.
-        // The LERP function uses x_frac as 't' and the max u32 value as 'tmax' (2^32-1)
-        // The LERP output is in the range of the VALUE_TABLE [0, 2 ^ NOISE_VALUE_EXP].
-        scaled_result = lerp(val0, val1, UINT_MAX, x_frac); // UINT_MAX is 2^32 - 1
+        if (period_us == state->sine.step_period_us &&
+            params->sampling_us == state->sine.step_sampling_us)
+                return;
 
-        // 5. Final Rescaling and Shifting to [MIN_TEMP, MAX_TEMP]
-        // The interpolation factor used in the scaling is 2 ^ NOISE_VALUE_EXP.
-        // Result = (scaled_result >> NOISE_VALUE_EXP) * result_range + MIN_TEMP
-        s64 final_val = (s64)scaled_result * result_range;
+        /* Whole periods don't move the phase. period_us fits in 32 bits,
+         * see GEN_PERIOD_MS_MAX, so the shift doesn't overflow */
+        (void)div64_u64_rem(params->sampling_us, period_us, &rem_us);
+        state->sine.step = (u32)div64_u64(rem_us << 32, period_us);
+        state->sine.step_period_us = period_us;
+        state->sine.step_sampling_us = params->sampling_us;
+}
+
+/**
+ * Sine of a phase, interpolated between the whole degrees of fixp_sin32()
+ * @param[in] phase Fraction of a turn, 2^32 per turn
+ * @return s32 - Sine, Q31
+ */
+static s32 sine_at(u32 phase)
+{
+        u64 degrees = (u64)phase * 360; /* Q32.32 */
+        int d = (int)(degrees >> 32);
+        s64 t = (u32)degrees >> (32 - NOISE_LERP_SHIFT);
+        s32 s0 = fixp_sin32(d);
+        s32 s1 = fixp_sin32(d + 1);
+
+        return s0 + (s32)(((s64)(s1 - s0) * t) >> NOISE_LERP_SHIFT);
+}
 
-        // Perform the division and add the minimum offset
-        final_val = (s64)((u64)final_val >> NOISE_VALUE_EXP);
+static s32 sine_temp(const struct simtemp_params *params, u32 phase)
+{
+        s32 temp = params->sine_offset_mC +
+                   (s32)(((s64)sine_at(phase) * params->sine_amplitude_mC) >> 31);
 
-        // 6. Return the clamped result
-        return (s32)final_val + MIN_TEMP;
+        /* The offset and amplitude are set separately, either may push the
+         * peaks out of the supported range */
+        return clamp(temp, MIN_TEMP, MAX_TEMP);
 }
 
-static s32 noisy_generator(void)
+static s32 sine_generator(const struct simtemp_params *params,
+                          struct simtemp_gen_state *state)
 {
-        /* Get random in the supported range, + 1 for inclusive ceil */
-        u32 rand = get_random_u32_below(MAX_TEMP - MIN_TEMP + 1);
-        return (s32)((s64)rand + (s64)MIN_TEMP);
+        sine_update_step(params, state);
+        state->sine.phase += state->sine.step;
+
+        return sine_temp(params, state->sine.phase);
 }
 
-static s32 ramp_generator(void)
+static void sine_batch(const struct simtemp_params *params,
+                       struct simtemp_gen_state *state,
+                       struct simtemp_sample *samples, unsigned int count)
 {
-        static u32 elapsed_time = 0;
+        unsigned int i;
 
-        elapsed_time += sampling_ms;
-        if (elapsed_time >= ramp_period_ms) {
-                elapsed_time = 0;
+        sine_update_step(params, state);
+        for (i = 0; i < count; i++) {
+                state->sine.phase += state->sine.step;
+                samples[i].temp_mC = sine_temp(params, state->sine.phase);
         }
+}
+
+static void square_init(const struct simtemp_params *params,
+                        struct simtemp_gen_state *state)
+{
+        state->square.elapsed_us = 0;
+}
+
+static s32 square_generator(const struct simtemp_params *params,
+                            struct simtemp_gen_state *state)
+{
+        u64 period_us = (u64)params->square_period_ms * USEC_PER_MSEC;
+
+        state->square.elapsed_us = advance_in_period(state->square.elapsed_us,
+                                                     params->sampling_us, period_us);
 
-        return lerp(ramp_min, ramp_max, ramp_period_ms, elapsed_time);
+        /* High for the first duty_pct of the period */
+        return (state->square.elapsed_us * 100 < period_us * params->square_duty_pct) ?
+               params->square_high_mC : params->square_low_mC;
 }
 
-void get_temp_sample(struct simtemp_sample *sample)
+static void walk_init(const struct simtemp_params *params,
+                      struct simtemp_gen_state *state)
 {
+        /* Halfway between the bounds, in whichever order they are */
+        state->walk.temp_mC = params->walk_min_mC +
+                              (params->walk_max_mC - params->walk_min_mC) / 2;
+}
+
+/**
+ * Random walk, each step uniform in [-step_mC, step_mC] and reflected off
+ * the bounds
+ */
+static s32 walk_generator(const struct simtemp_params *params,
+                          struct simtemp_gen_state *state)
+{
+        s32 lo = min(params->walk_min_mC, params->walk_max_mC);
+        s32 hi = max(params->walk_min_mC, params->walk_max_mC);
+        s32 step = params->walk_step_mC;
         s32 temp;
-        
-        switch (mode)
-        {
-        case simtemp_mode_normal:
-                temp = normal_generator();
-                break;
-        case simtemp_mode_noisy:
-                temp = noisy_generator();
-                break;
-        case simtemp_mode_ramp:
-                temp = ramp_generator();
-                break;
-        default:
-                /* should never come here */
-                temp = 0;
-                break;
+
+        temp = state->walk.temp_mC - step +
+               (s32)gen_random(params, state, 2 * (u32)step + 1);
+        if (temp > hi)
+                temp = 2 * hi - temp;
+        if (temp < lo)
+                temp = 2 * lo - temp;
+
+        /* A step wider than the bounds can bounce past the other one */
+        state->walk.temp_mC = clamp(temp, lo, hi);
+        return state->walk.temp_mC;
+}
+
+static void thermal_init(const struct simtemp_params *params,
+                         struct simtemp_gen_state *state)
+{
+        /* Starts cold, with the heater just turned on */
+        state->thermal.temp = (s64)params->thermal_ambient_mC << 16;
+        state->thermal.elapsed_us = 0;
+        state->thermal.alpha = 0;
+        state->thermal.alpha_tau_us = 0;
+        state->thermal.alpha_sampling_us = 0;
+}
+
+/**
+ * Newton's law of heating and cooling: the temperature closes the gap to the
+ * target exponentially, with time constant tau. Heats towards heated_mC for
+ * the first half of the period, then cools towards ambient_mC.
+ */
+static s32 thermal_generator(const struct simtemp_params *params,
+                             struct simtemp_gen_state *state)
+{
+        u64 period_us = (u64)params->thermal_period_ms * USEC_PER_MSEC;
+        u64 tau_us = (u64)params->thermal_tau_ms * USEC_PER_MSEC;
+        u64 dt_us;
+        s64 gap;
+        s32 target;
+
+        /* Only divides when tau or the sampling changed. A backward Euler
+         * step closes dt / (tau + dt) of the gap, which never overshoots
+         * however long the sampling is. dt is capped to 32 bits, over an
+         * hour, so the shift doesn't overflow */
+        if (tau_us != state->thermal.alpha_tau_us ||
+            params->sampling_us != state->thermal.alpha_sampling_us) {
+                dt_us = min_t(u64, params->sampling_us, U32_MAX);
+                state->thermal.alpha = (u32)div64_u64(dt_us << 32, tau_us + dt_us);
+                state->thermal.alpha_tau_us = tau_us;
+                state->thermal.alpha_sampling_us = params->sampling_us;
         }
 
-        sample->timestamp = ktime_to_ns(ktime_get_boottime());
-        sample->temp_mC = temp;
+        state->thermal.elapsed_us = advance_in_period(state->thermal.elapsed_us,
+                                                      params->sampling_us, period_us);
+        target = (state->thermal.elapsed_us * 2 < period_us) ?
+                 params->thermal_heated_mC : params->thermal_ambient_mC;
+
+        gap = ((s64)target << 16) - state->thermal.temp;
+        if (gap >= 0)
+                state->thermal.temp += mul_u64_u32_shr(gap, state->thermal.alpha, 32);
+        else
+                state->thermal.temp -= mul_u64_u32_shr(-gap, state->thermal.alpha, 32);
+
+        return (s32)((state->thermal.temp + (1 << 15)) >> 16);
+}
+
+/* A seed restarts the trace too, so the samples replay the same */
+static void replay_init(const struct simtemp_params *params,
+                        struct simtemp_gen_state *state)
+{
+        if (state->replay)
+                replay_rewind(state->replay);
+}
+
+static s32 replay_generator(const struct simtemp_params *params,
+                            struct simtemp_gen_state *state)
+{
+        if (!state->replay)
+                return REPLAY_IDLE_MC;
+
+        return replay_next(state->replay, params->sampling_us, params->replay_speed_pct,
+                           params->replay_loop);
+}
+
+/**
+ * Seed the noisy generator's PRNG
+ * @param[out] prng xoshiro128** state
+ * @param[in] seed Any value, 0 included
+ */
+static void seed_prng(u32 prng[4], u64 seed)
+{
+        unsigned int i;
+        u64 z;
+
+        /* Expanded with SplitMix64, as recommended for seeding xoshiro, so
+         * close seeds still give unrelated states */
+        for (i = 0; i < 4; i++) {
+                seed += 0x9E3779B97F4A7C15ULL;
+                z = seed;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                prng[i] = (u32)((z ^ (z >> 31)) >> 32);
+        }
+
+        /* The one state xoshiro can't leave */
+        if (!(prng[0] | prng[1] | prng[2] | prng[3]))
+                prng[0] = 1;
+}
+
+/**
+ * Fill the noise table with a smooth curve through NOISE_POINTS random
+ * control points, eased in and out of each with smootherstep. Done once per
+ * seed, so it may take its time.
+ * @param[out] table Noise table of an instance
+ * @param[in,out] prng Seeded PRNG to draw the control points from
+ */
+static void build_noise_table(s32 *table, u32 prng[4])
+{
+        s32 points[NOISE_POINTS];
+        unsigned int i;
+        s32 v0, v1;
+        u32 t;
+
+        for (i = 0; i < NOISE_POINTS; i++)
+                points[i] = (s32)(((u64)xoshiro128ss(prng) * ((1 << NOISE_VALUE_EXP) + 1)) >> 32);
+
+        for (i = 0; i < NOISE_TABLE_SIZE; i++) {
+                v0 = points[i >> NOISE_POINT_SHIFT];
+                v1 = points[((i >> NOISE_POINT_SHIFT) + 1) % NOISE_POINTS];
+                t = smootherstep((i & ((1 << NOISE_POINT_SHIFT) - 1)) <<
+                                 (16 - NOISE_POINT_SHIFT));
+                table[i] = v0 + (s32)(((s64)(v1 - v0) * t) >> 16);
+        }
+}
+
+static const struct simtemp_generator_ops normal_ops = {
+        .name = "normal",
+        .init = normal_init,
+        .next = normal_generator,
+};
+
+static const struct simtemp_generator_ops noisy_ops = {
+        .name = "noisy",
+        .next = noisy_generator,
+};
+
+static const struct simtemp_generator_ops ramp_ops = {
+        .name = "ramp",
+        .init = ramp_init,
+        .next = ramp_generator,
+};
+
+static const struct simtemp_generator_ops sine_ops = {
+        .name = "sine",
+        .init = sine_init,
+        .next = sine_generator,
+        .next_batch = sine_batch,
+        .params = {
+                GEN_PARAM("period_ms", sine_period_ms, 1, GEN_PERIOD_MS_MAX, 10000),
+                GEN_PARAM("amplitude_mC", sine_amplitude_mC, 0,
+                          (MAX_TEMP - MIN_TEMP) / 2, 20000),
+                GEN_PARAM("offset_mC", sine_offset_mC, MIN_TEMP, MAX_TEMP, 45000),
+        },
+};
+
+static const struct simtemp_generator_ops square_ops = {
+        .name = "square",
+        .init = square_init,
+        .next = square_generator,
+        .params = {
+                GEN_PARAM("low_mC", square_low_mC, MIN_TEMP, MAX_TEMP, 25000),
+                GEN_PARAM("high_mC", square_high_mC, MIN_TEMP, MAX_TEMP, 60000),
+                GEN_PARAM("period_ms", square_period_ms, 1, GEN_PERIOD_MS_MAX, 10000),
+                GEN_PARAM("duty_pct", square_duty_pct, 0, 100, 50),
+        },
+};
+
+static const struct simtemp_generator_ops walk_ops = {
+        .name = "walk",
+        .init = walk_init,
+        .next = walk_generator,
+        .params = {
+                GEN_PARAM("step_mC", walk_step_mC, 0, MAX_TEMP - MIN_TEMP, 200),
+                GEN_PARAM("min_mC", walk_min_mC, MIN_TEMP, MAX_TEMP, 0),
+                GEN_PARAM("max_mC", walk_max_mC, MIN_TEMP, MAX_TEMP, 100000),
+        },
+};
+
+static const struct simtemp_generator_ops thermal_ops = {
+        .name = "thermal",
+        .init = thermal_init,
+        .next = thermal_generator,
+        .params = {
+                GEN_PARAM("ambient_mC", thermal_ambient_mC, MIN_TEMP, MAX_TEMP, 25000),
+                GEN_PARAM("heated_mC", thermal_heated_mC, MIN_TEMP, MAX_TEMP, 85000),
+                GEN_PARAM("tau_ms", thermal_tau_ms, 1, GEN_PERIOD_MS_MAX, 10000),
+                GEN_PARAM("period_ms", thermal_period_ms, 1, GEN_PERIOD_MS_MAX, 120000),
+        },
+};
+
+static const struct simtemp_generator_ops replay_ops = {
+        .name = "replay",
+        .init = replay_init,
+        .next = replay_generator,
+        .params = {
+                GEN_PARAM("speed_pct", replay_speed_pct, 0, 10000, 0),
+                GEN_PARAM("loop", replay_loop, 0, 1, 1),
+        },
+};
+
+/* Every mode has an entry, mode_store() only accepts these */
+const struct simtemp_generator_ops *const simtemp_generators[simtemp_mode_count] = {
+        [simtemp_mode_normal] = &normal_ops,
+        [simtemp_mode_noisy] = &noisy_ops,
+        [simtemp_mode_ramp] = &ramp_ops,
+        [simtemp_mode_sine] = &sine_ops,
+        [simtemp_mode_square] = &square_ops,
+        [simtemp_mode_walk] = &walk_ops,
+        [simtemp_mode_thermal] = &thermal_ops,
+        [simtemp_mode_replay] = &replay_ops,
+};
+
+/**
+ * Set the parameters of the generators in simtemp_generators to their
+ * defaults
+ * @param[out] params Configuration of an instance
+ */
+void init_gen_params(struct simtemp_params *params)
+{
+        const struct simtemp_gen_param *param;
+        unsigned int mode, i;
+
+        for (mode = 0; mode < simtemp_mode_count; mode++) {
+                for (i = 0; i < GEN_PARAMS_MAX; i++) {
+                        param = &simtemp_generators[mode]->params[i];
+                        if (!param->name)
+                                break;
+                        *(s32 *)((u8 *)params + param->offset) = param->def;
+                }
+        }
+}
+
+/**
+ * Set the generators to their starting point. The same seed always gives
+ * the same noise table and the same sequence of samples, in every mode.
+ * @param[out] state Generator state of an instance
+ * @param[in] params Configuration of the instance, the seed and whatever
+ *                   the generators start from
+ */
+void init_gen_state(struct simtemp_gen_state *state,
+                    const struct simtemp_params *params)
+{
+        unsigned int mode;
+
+        seed_prng(state->prng, params->seed);
+        build_noise_table(state->noise_table, state->prng);
+        for (mode = 0; mode < simtemp_mode_count; mode++) {
+                if (simtemp_generators[mode]->init)
+                        simtemp_generators[mode]->init(params, state);
+        }
+}
+
+/**
+ * Get the next sample from the generator selected by `mode`
+ * @param[out] sample Sample, stamped with timestamp
+ * @param[in] timestamp Boot time the sample is taken at
+ * @param[in] params Configuration of the instance
+ * @param[in,out] state Generator state of the instance
+ */
+void get_temp_sample(struct simtemp_sample *sample, ktime_t timestamp,
+                     const struct simtemp_params *params,
+                     struct simtemp_gen_state *state)
+{
+        sample->timestamp = ktime_to_ns(timestamp);
+        sample->temp_mC = simtemp_generators[params->mode]->next(params, state);
+        sample->flags = 0;
+}
+
+/**
+ * Get the next count samples from the generator selected by `mode`, in one
+ * call to its next_batch() if it has one. Same samples as count calls to
+ * get_temp_sample().
+ * @param[out] samples Room for count samples
+ * @param[in] count Number of samples
+ * @param[in] timestamp Boot time of the first sample
+ * @param[in] period_ns Time between two samples
+ * @param[in] params Configuration of the instance
+ * @param[in,out] state Generator state of the instance
+ */
+void get_temp_samples(struct simtemp_sample *samples, unsigned int count,
+                      ktime_t timestamp, u64 period_ns,
+                      const struct simtemp_params *params,
+                      struct simtemp_gen_state *state)
+{
+        const struct simtemp_generator_ops *ops = simtemp_generators[params->mode];
+        u64 timestamp_ns = ktime_to_ns(timestamp);
+        unsigned int i;
+
+        if (ops->next_batch) {
+                ops->next_batch(params, state, samples, count);
+        } else {
+                for (i = 0; i < count; i++)
+                        samples[i].temp_mC = ops->next(params, state);
+        }
+
+        for (i = 0; i < count; i++) {
+                samples[i].timestamp = timestamp_ns + i * period_ns;
+                samples[i].flags = 0;
+        }
 }
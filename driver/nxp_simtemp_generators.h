@@ -4,6 +4,111 @@
 #include "nxp_simtemp.h"
 #include "nxp_simtemp_sysfs.h"
 
-void get_temp_sample(struct simtemp_sample *sample);
+#include <linux/ktime.h>
+
+struct simtemp_replay;
+
+#define NOISE_TABLE_SIZE   256
+#define NOISE_TABLE_MASK   (NOISE_TABLE_SIZE - 1)
+/* Noise values are in [0, 2^NOISE_VALUE_EXP] */
+#define NOISE_VALUE_EXP    24
+/* Fractional bits of the interpolation factor */
+#define NOISE_LERP_SHIFT   16
+#define NOISE_OCTAVES_MAX  8
+/* Default position increment per sample of the normal mode, in 1/2^32 of a
+ * table entry */
+#define NOISE_SPEED_DEFAULT 0x7000FFFF
+/* Most parameters a generator can have in its sysfs directory */
+#define GEN_PARAMS_MAX     4
+/* Longest period of the generators below, 1 h, so it fits in 32 bits of us */
+#define GEN_PERIOD_MS_MAX  3600000
+
+/* Per-instance generator state, each generator only touches its own */
+struct simtemp_gen_state {
+    u64 current_position; /* Normal: Q32.32 position in the noise table */
+    u64 elapsed_us;       /* Ramp: time into the current period */
+    u32 prng[4];          /* Noisy, walk: xoshiro128** state, see `seed` */
+    struct {
+        u32 phase;        /* Fraction of a turn, 2^32 per turn */
+        u32 step;         /* Phase increment per sample */
+        u64 step_period_us;   /* Period and sampling step was computed for */
+        u64 step_sampling_us;
+    } sine;
+    struct {
+        u64 elapsed_us;   /* Time into the current period */
+    } square;
+    struct {
+        s32 temp_mC;      /* Latest sample */
+    } walk;
+    struct {
+        s64 temp;         /* Latest sample, Q16 milli-Celsius */
+        u64 elapsed_us;   /* Time into the current heating/cooling cycle */
+        u32 alpha;        /* Q32 fraction of the gap closed per sample */
+        u64 alpha_tau_us; /* Time constant and sampling alpha was computed for */
+        u64 alpha_sampling_us;
+    } thermal;
+    struct simtemp_replay *replay; /* Replay: trace and cursor of the
+                                    * instance, set by the core */
+    s32 noise_table[NOISE_TABLE_SIZE]; /* Normal: built from the seed */
+};
+
+/* A parameter of a generator, the <name> attribute of its sysfs directory.
+ * Stored as an s32 at offset in struct simtemp_params */
+struct simtemp_gen_param {
+    const char *name;
+    size_t offset;
+    s32 min;
+    s32 max;
+    s32 def;
+};
+
+/* A signal generator, see simtemp_generators */
+struct simtemp_generator_ops {
+    const char *name;   /* Value of the `mode` attribute that selects it */
+    /* Optional, back to the starting point, prng is seeded already */
+    void (*init)(const struct simtemp_params *params,
+                 struct simtemp_gen_state *state);
+    /* Temperature of the next sample, in milli-Celsius */
+    s32 (*next)(const struct simtemp_params *params,
+                struct simtemp_gen_state *state);
+    /* Optional, count samples at once, same as count calls to next() */
+    void (*next_batch)(const struct simtemp_params *params,
+                       struct simtemp_gen_state *state,
+                       struct simtemp_sample *samples, unsigned int count);
+    /* Shown in the sysfs directory named after the generator, up to the
+     * first without a name. None for the ones that predate the directories,
+     * their parameters are top level attributes */
+    struct simtemp_gen_param params[GEN_PARAMS_MAX];
+};
+
+/* Indexed by enum simtemp_generator_mode */
+extern const struct simtemp_generator_ops *const simtemp_generators[simtemp_mode_count];
+
+/**
+ * Value at a Q32.32 position of the noise table, wrapping around it. Linear
+ * interpolation with a Q16 factor, so a multiply and a shift.
+ * @param[in] table Noise table, NOISE_TABLE_SIZE entries
+ * @param[in] position Q32.32 position in it
+ * @return s32 - Value in [0, 2^NOISE_VALUE_EXP]
+ */
+static inline s32 noise_at(const s32 *table, u64 position)
+{
+    u32 i0 = (u32)(position >> 32) & NOISE_TABLE_MASK;
+    u32 i1 = (i0 + 1) & NOISE_TABLE_MASK;
+    s64 t = (u32)position >> (32 - NOISE_LERP_SHIFT);
+
+    return table[i0] + (s32)(((s64)(table[i1] - table[i0]) * t) >> NOISE_LERP_SHIFT);
+}
+
+void init_gen_params(struct simtemp_params *params);
+void init_gen_state(struct simtemp_gen_state *state,
+                    const struct simtemp_params *params);
+void get_temp_sample(struct simtemp_sample *sample, ktime_t timestamp,
+                     const struct simtemp_params *params,
+                     struct simtemp_gen_state *state);
+void get_temp_samples(struct simtemp_sample *samples, unsigned int count,
+                      ktime_t timestamp, u64 period_ns,
+                      const struct simtemp_params *params,
+                      struct simtemp_gen_state *state);
 
 #endif
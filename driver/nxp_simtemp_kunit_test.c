@@ -0,0 +1,486 @@
+/*
+ * KUnit suite for the ring buffer, the signal generators and the producer
+ * tick.
+ *
+ * Linked into the nxp_simtemp module when CONFIG_NXP_SIMTEMP_KUNIT_TEST is
+ * set (see Kbuild), and runs when it is loaded: out of tree with
+ * `make kunit` and insmod, or in a kernel tree under kunit.py, UML or QEMU,
+ * with the .kunitconfig next to this file. The cases set up their own
+ * components, so they don't touch the probed instances.
+ *
+ * The timed cases report ns and cycles per call through kunit_info(). They
+ * never fail, they are there to compare two builds. get_cycles() has no
+ * counter on some architectures, UML among them, which report 0 cycles.
+ */
+#include <kunit/test.h>
+#include <linux/bottom_half.h>
+#include <linux/string.h>
+#include <linux/timex.h>
+#include <linux/wait.h>
+#include <linux/percpu.h>
+#include <linux/atomic.h>
+
+#include "nxp_simtemp.h"
+#include "nxp_simtemp_buffer.h"
+#include "nxp_simtemp_generators.h"
+#include "nxp_simtemp_sysfs.h"
+#include "nxp_simtemp_replay.h"
+#include "nxp_simtemp_rollup.h"
+#include "nxp_simtemp_window.h"
+#include "nxp_simtemp_alarm.h"
+#include "nxp_simtemp_debugfs.h"
+#include "nxp_simtemp_core.h"
+#include "nxp_simtemp_producer.h"
+
+/* Samples each generator is checked over, 10 s at the test sampling */
+#define RANGE_SAMPLES      10000
+#define TEST_SAMPLING_US   1000
+/* Calls per timed case, the tick cases divide it by their consumers */
+#define BENCH_ITERATIONS   100000
+#define BENCH_TICKS_MIN    100
+
+/* The defaults of a new instance, with a fixed seed */
+static void init_test_params(struct simtemp_params *params, enum simtemp_generator_mode mode,
+                             u64 seed)
+{
+        init_params(params);
+        params->mode = mode;
+        params->seed = seed;
+        params->sampling_us = TEST_SAMPLING_US;
+}
+
+static struct simtemp_sample test_sample(u64 timestamp)
+{
+        return (struct simtemp_sample){ .timestamp = timestamp, .temp_mC = (s32)timestamp };
+}
+
+/* The producer pushes with bottom halves disabled, see ring_buffer_push() */
+static bool test_push(struct lifo_ring_buffer *rb, u64 timestamp)
+{
+        struct simtemp_sample sample = test_sample(timestamp);
+        bool overwritten;
+
+        local_bh_disable();
+        overwritten = ring_buffer_push(rb, &sample);
+        local_bh_enable();
+
+        return overwritten;
+}
+
+static struct lifo_ring_buffer *test_ring(struct kunit *test, size_t capacity)
+{
+        struct lifo_ring_buffer *rb = init_ring_buffer();
+        int err;
+
+        KUNIT_ASSERT_NOT_NULL(test, rb);
+        err = ring_buffer_resize(rb, capacity);
+        if (err)
+                destroy_ring_buffer(rb);
+        KUNIT_ASSERT_EQ(test, err, 0);
+
+        return rb;
+}
+
+/*
+ * One slot of the ring always stays free, so a ring of capacity 4 holds the
+ * last 3 samples. Pushing 10 wraps around it more than twice.
+ */
+static void ring_push_peek_wrap_test(struct kunit *test)
+{
+        struct lifo_ring_buffer *rb = test_ring(test, 4);
+        struct simtemp_sample sample;
+        u64 published;
+        size_t i;
+
+        for (i = 1; i <= 10; i++)
+                KUNIT_EXPECT_EQ(test, test_push(rb, i), (bool)(i > 3));
+
+        KUNIT_EXPECT_EQ(test, get_ring_buffer_capacity(rb), (size_t)4);
+        KUNIT_EXPECT_EQ(test, get_ring_buffer_size(rb), (size_t)3);
+        KUNIT_EXPECT_EQ(test, ring_buffer_get_published(rb), 10ULL);
+
+        /* Index 0 is the oldest entry */
+        for (i = 0; i < 3; i++) {
+                KUNIT_ASSERT_EQ(test, ring_buffer_peek(rb, i, &sample), 0);
+                KUNIT_EXPECT_EQ(test, sample.timestamp, 8ULL + i);
+                KUNIT_EXPECT_EQ(test, sample.temp_mC, (s32)(8 + i));
+        }
+        KUNIT_EXPECT_NE(test, ring_buffer_peek(rb, 3, &sample), 0);
+
+        KUNIT_ASSERT_EQ(test, ring_buffer_peek_latest(rb, &sample, &published), 0);
+        KUNIT_EXPECT_EQ(test, sample.timestamp, 10ULL);
+        KUNIT_EXPECT_EQ(test, published, 10ULL);
+
+        destroy_ring_buffer(rb);
+}
+
+/* A span of the history that crosses the end of the storage comes back in
+ * order, split in two copies */
+static void ring_peek_range_wrap_test(struct kunit *test)
+{
+        struct lifo_ring_buffer *rb = test_ring(test, 8);
+        struct simtemp_sample samples[7];
+        u64 published;
+        size_t i;
+
+        for (i = 1; i <= 12; i++)
+                test_push(rb, i);
+
+        KUNIT_ASSERT_EQ(test, ring_buffer_peek_range(rb, 0, ARRAY_SIZE(samples), samples,
+                                                     &published), ARRAY_SIZE(samples));
+        KUNIT_EXPECT_EQ(test, published, 12ULL);
+        for (i = 0; i < ARRAY_SIZE(samples); i++)
+                KUNIT_EXPECT_EQ(test, samples[i].timestamp, 6ULL + i);
+
+        destroy_ring_buffer(rb);
+}
+
+static void ring_peek_latest_empty_test(struct kunit *test)
+{
+        struct lifo_ring_buffer *rb = test_ring(test, 4);
+        struct simtemp_sample sample;
+        u64 published = U64_MAX;
+
+        KUNIT_EXPECT_EQ(test, get_ring_buffer_size(rb), (size_t)0);
+        KUNIT_EXPECT_NE(test, ring_buffer_peek_latest(rb, &sample, &published), 0);
+        KUNIT_EXPECT_EQ(test, published, 0ULL);
+        KUNIT_EXPECT_NE(test, ring_buffer_peek(rb, 0, &sample), 0);
+
+        /* Empty again after a clear, the published count carries on */
+        test_push(rb, 1);
+        KUNIT_EXPECT_EQ(test, ring_buffer_peek_latest(rb, &sample, &published), 0);
+        clear_ring_buffer(rb);
+        KUNIT_EXPECT_NE(test, ring_buffer_peek_latest(rb, &sample, &published), 0);
+        KUNIT_EXPECT_EQ(test, published, 1ULL);
+
+        destroy_ring_buffer(rb);
+}
+
+static u64 table_position(u32 index, u32 fraction)
+{
+        return ((u64)index << 32) | fraction;
+}
+
+/* noise_at() is the Q16 linear interpolation of the noise table */
+static void noise_interpolation_test(struct kunit *test)
+{
+        s32 *table = kunit_kcalloc(test, NOISE_TABLE_SIZE, sizeof(s32), GFP_KERNEL);
+        const s32 full = 1 << NOISE_VALUE_EXP;
+        s32 value, prev = full;
+        u32 fraction;
+
+        KUNIT_ASSERT_NOT_NULL(test, table);
+        table[0] = 1000;
+        table[1] = 3000;
+        table[2] = full;
+        table[3] = 0;
+        table[NOISE_TABLE_SIZE - 1] = 5000;
+
+        /* On an entry, whatever the one after it */
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(0, 0)), 1000);
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(2, 0)), full);
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(3, 0)), 0);
+
+        /* Halfway, rising and falling */
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(0, 0x80000000)), 2000);
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(2, 0x80000000)), full / 2);
+
+        /* Below the next entry by the truncated factor, never past it */
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(2, U32_MAX)), full >> 16);
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(1, U32_MAX)),
+                        full - ((full - 3000) >> 16) - 1);
+
+        /* The bits below the factor don't matter */
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(0, 0x0000FFFF)), 1000);
+
+        /* The last entry interpolates towards the first, and the position
+         * wraps around the table */
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(NOISE_TABLE_SIZE - 1, 0x80000000)),
+                        3000);
+        KUNIT_EXPECT_EQ(test, noise_at(table, table_position(NOISE_TABLE_SIZE + 1, 0)), 3000);
+
+        /* Full scale down, monotonic and within [0, 2^NOISE_VALUE_EXP] */
+        for (fraction = 0; fraction < 0xFFFF0000; fraction += 0x00010000) {
+                value = noise_at(table, table_position(2, fraction));
+                KUNIT_EXPECT_GE(test, value, 0);
+                KUNIT_EXPECT_LE(test, value, prev);
+                prev = value;
+        }
+}
+
+static const enum simtemp_generator_mode gen_modes[] = {
+        simtemp_mode_normal, simtemp_mode_noisy, simtemp_mode_ramp, simtemp_mode_sine,
+        simtemp_mode_square, simtemp_mode_walk, simtemp_mode_thermal, simtemp_mode_replay,
+};
+
+static void gen_mode_desc(const enum simtemp_generator_mode *mode, char *desc)
+{
+        strscpy(desc, simtemp_generators[*mode]->name, KUNIT_PARAM_DESC_SIZE);
+}
+
+KUNIT_ARRAY_PARAM(gen_mode, gen_modes, gen_mode_desc);
+
+/* Bounds of a generator with the default parameters */
+static void gen_range(const struct simtemp_params *params, s32 *lo, s32 *hi)
+{
+        *lo = MIN_TEMP;
+        *hi = MAX_TEMP;
+
+        switch (params->mode) {
+        case simtemp_mode_ramp:
+                *lo = params->ramp_min;
+                *hi = params->ramp_max;
+                break;
+        case simtemp_mode_sine:
+                *lo = max(params->sine_offset_mC - params->sine_amplitude_mC, MIN_TEMP);
+                *hi = min(params->sine_offset_mC + params->sine_amplitude_mC, MAX_TEMP);
+                break;
+        case simtemp_mode_square:
+                *lo = params->square_low_mC;
+                *hi = params->square_high_mC;
+                break;
+        case simtemp_mode_walk:
+                *lo = params->walk_min_mC;
+                *hi = params->walk_max_mC;
+                break;
+        case simtemp_mode_thermal:
+                *lo = min(params->thermal_ambient_mC, params->thermal_heated_mC);
+                *hi = max(params->thermal_ambient_mC, params->thermal_heated_mC);
+                break;
+        case simtemp_mode_replay:
+                /* No trace loaded */
+                *lo = REPLAY_IDLE_MC;
+                *hi = REPLAY_IDLE_MC;
+                break;
+        default:
+                break;
+        }
+}
+
+/* Every generator stays within the supported range, and within its own
+ * bounds, over a few seeds */
+static void generator_range_test(struct kunit *test)
+{
+        const enum simtemp_generator_mode *mode = test->param_value;
+        struct simtemp_params params;
+        struct simtemp_gen_state *state;
+        struct simtemp_sample sample;
+        unsigned int i;
+        u64 seed;
+        s32 lo, hi;
+
+        state = kunit_kzalloc(test, sizeof(*state), GFP_KERNEL);
+        KUNIT_ASSERT_NOT_NULL(test, state);
+
+        for (seed = 0; seed < 3; seed++) {
+                init_test_params(&params, *mode, seed);
+                init_gen_state(state, &params);
+                gen_range(&params, &lo, &hi);
+
+                for (i = 0; i < RANGE_SAMPLES; i++) {
+                        get_temp_sample(&sample, (ktime_t)i * TEST_SAMPLING_US * NSEC_PER_USEC,
+                                        &params, state);
+                        KUNIT_ASSERT_GE_MSG(test, sample.temp_mC, lo, "sample %u, seed %llu",
+                                            i, seed);
+                        KUNIT_ASSERT_LE_MSG(test, sample.temp_mC, hi, "sample %u, seed %llu",
+                                            i, seed);
+                }
+        }
+}
+
+static void report_timing(struct kunit *test, const char *name, u64 calls,
+                          u64 elapsed_ns, u64 cycles)
+{
+        kunit_info(test, "%s: %llu ns/call, %llu cycles/call\n", name,
+                   div64_u64(elapsed_ns, calls), div64_u64(cycles, calls));
+}
+
+static void bench_generator(struct kunit *test, enum simtemp_generator_mode mode)
+{
+        s32 (*next)(const struct simtemp_params *, struct simtemp_gen_state *) =
+                simtemp_generators[mode]->next;
+        struct simtemp_params params;
+        struct simtemp_gen_state *state;
+        u64 start_ns, elapsed_ns;
+        cycles_t start_cycles, cycles;
+        s64 sum = 0;
+        unsigned int i;
+
+        state = kunit_kzalloc(test, sizeof(*state), GFP_KERNEL);
+        KUNIT_ASSERT_NOT_NULL(test, state);
+        init_test_params(&params, mode, 1);
+        init_gen_state(state, &params);
+
+        start_ns = ktime_get_ns();
+        start_cycles = get_cycles();
+        for (i = 0; i < BENCH_ITERATIONS; i++)
+                sum += next(&params, state);
+        cycles = get_cycles() - start_cycles;
+        elapsed_ns = ktime_get_ns() - start_ns;
+
+        /* Keeps the calls from being optimized out */
+        KUNIT_EXPECT_NE(test, sum, S64_MIN);
+        report_timing(test, simtemp_generators[mode]->name, BENCH_ITERATIONS, elapsed_ns, cycles);
+}
+
+static void bench_normal_test(struct kunit *test)
+{
+        bench_generator(test, simtemp_mode_normal);
+}
+
+static void bench_noisy_test(struct kunit *test)
+{
+        bench_generator(test, simtemp_mode_noisy);
+}
+
+static void bench_ramp_test(struct kunit *test)
+{
+        bench_generator(test, simtemp_mode_ramp);
+}
+
+static const unsigned int tick_consumers[] = { 1, 100, 10000 };
+
+static void tick_consumers_desc(const unsigned int *consumers, char *desc)
+{
+        snprintf(desc, KUNIT_PARAM_DESC_SIZE, "%u consumers", *consumers);
+}
+
+KUNIT_ARRAY_PARAM(tick, tick_consumers, tick_consumers_desc);
+
+/* A consumer blocked in read() or poll(), the wakeup only marks it */
+struct tick_consumer {
+        struct wait_queue_entry wait;
+        bool woken;
+        u64 consumed; /* Published count of the latest sample it fetched */
+};
+
+static int tick_consumer_wake(struct wait_queue_entry *wait, unsigned int mode,
+                              int flags, void *key)
+{
+        struct tick_consumer *consumer = container_of(wait, struct tick_consumer, wait);
+
+        consumer->woken = true;
+        return 1;
+}
+
+static void destroy_tick_device(nxp_simtemp_dev_t *simtemp_dev)
+{
+        free_percpu(simtemp_dev->tick_jitter);
+        free_percpu(simtemp_dev->stats);
+        destroy_alarms(simtemp_dev->alarms);
+        destroy_window(simtemp_dev->window);
+        destroy_rollup(simtemp_dev->rollup);
+        destroy_ring_buffer(simtemp_dev->ring);
+}
+
+/* Just what producer_tick() uses of an instance, as probe sets it up */
+static nxp_simtemp_dev_t *init_tick_device(struct kunit *test)
+{
+        nxp_simtemp_dev_t *simtemp_dev = kunit_kzalloc(test, sizeof(*simtemp_dev), GFP_KERNEL);
+        bool ready;
+
+        KUNIT_ASSERT_NOT_NULL(test, simtemp_dev);
+        init_test_params(&simtemp_dev->params, simtemp_mode_normal, 1);
+        init_gen_state(&simtemp_dev->gen, &simtemp_dev->params);
+        init_waitqueue_head(&simtemp_dev->wq);
+        atomic64_set(&simtemp_dev->wake_target, S64_MAX);
+        atomic64_set(&simtemp_dev->wake_deadline, S64_MAX);
+
+        simtemp_dev->ring = test_ring(test, BUFFER_CAPACITY);
+        simtemp_dev->rollup = init_rollup();
+        simtemp_dev->window = init_window(WINDOW_SIZE_DEFAULT);
+        simtemp_dev->alarms = init_alarms();
+        simtemp_dev->stats = alloc_percpu(struct simtemp_stats);
+        simtemp_dev->tick_jitter = alloc_percpu(struct simtemp_hist);
+        ready = simtemp_dev->rollup && simtemp_dev->window && simtemp_dev->alarms &&
+                simtemp_dev->stats && simtemp_dev->tick_jitter;
+        if (!ready)
+                destroy_tick_device(simtemp_dev);
+        KUNIT_ASSERT_TRUE_MSG(test, ready, "Failed to set up the instance");
+
+        return simtemp_dev;
+}
+
+/*
+ * producer_tick() as the backends run it, with K consumers waiting on the
+ * instance for every sample: the tick generates and pushes the sample,
+ * updates the rollups, window, alarms, stats and tick_jitter, and wakes the
+ * waiters through notify_consumers(). Then each woken consumer fetches the
+ * latest sample, and registers for the next one, like read() on the latest
+ * entry does. The timer or kthread dispatch and the consumers' syscalls
+ * and copies to userspace are not part of the number.
+ */
+static void bench_tick_test(struct kunit *test)
+{
+        const unsigned int consumers = *(const unsigned int *)test->param_value;
+        u64 ticks = max_t(u64, BENCH_ITERATIONS / consumers, BENCH_TICKS_MIN);
+        nxp_simtemp_dev_t *simtemp_dev = init_tick_device(test);
+        struct tick_consumer *consumer;
+        struct simtemp_sample sample;
+        u64 start_ns, elapsed_ns;
+        cycles_t start_cycles, cycles;
+        s64 sum = 0;
+        unsigned int c;
+        u64 t;
+
+        consumer = kunit_kcalloc(test, consumers, sizeof(*consumer), GFP_KERNEL);
+        if (!consumer)
+                destroy_tick_device(simtemp_dev);
+        KUNIT_ASSERT_NOT_NULL(test, consumer);
+        for (c = 0; c < consumers; c++) {
+                init_waitqueue_func_entry(&consumer[c].wait, tick_consumer_wake);
+                add_wait_queue(&simtemp_dev->wq, &consumer[c].wait);
+        }
+
+        start_ns = ktime_get_ns();
+        start_cycles = get_cycles();
+        for (t = 0; t < ticks; t++) {
+                atomic64_set(&simtemp_dev->wake_target, t + 1);
+
+                local_bh_disable();
+                producer_tick(simtemp_dev);
+                local_bh_enable();
+
+                for (c = 0; c < consumers; c++) {
+                        if (!consumer[c].woken)
+                                continue;
+                        consumer[c].woken = false;
+                        ring_buffer_peek_latest(simtemp_dev->ring, &sample,
+                                                &consumer[c].consumed);
+                        sum += sample.temp_mC;
+                }
+        }
+        cycles = get_cycles() - start_cycles;
+        elapsed_ns = ktime_get_ns() - start_ns;
+
+        for (c = 0; c < consumers; c++)
+                remove_wait_queue(&simtemp_dev->wq, &consumer[c].wait);
+
+        /* Every consumer was woken up for every tick */
+        for (c = 0; c < consumers; c++)
+                KUNIT_EXPECT_EQ(test, consumer[c].consumed, ticks);
+        KUNIT_EXPECT_NE(test, sum, S64_MIN);
+        report_timing(test, "tick", ticks, elapsed_ns, cycles);
+
+        destroy_tick_device(simtemp_dev);
+}
+
+static struct kunit_case nxp_simtemp_test_cases[] = {
+        KUNIT_CASE(ring_push_peek_wrap_test),
+        KUNIT_CASE(ring_peek_range_wrap_test),
+        KUNIT_CASE(ring_peek_latest_empty_test),
+        KUNIT_CASE(noise_interpolation_test),
+        KUNIT_CASE_PARAM(generator_range_test, gen_mode_gen_params),
+        KUNIT_CASE(bench_normal_test),
+        KUNIT_CASE(bench_noisy_test),
+        KUNIT_CASE(bench_ramp_test),
+        KUNIT_CASE_PARAM(bench_tick_test, tick_gen_params),
+        {}
+};
+
+static struct kunit_suite nxp_simtemp_test_suite = {
+        .name = "nxp_simtemp",
+        .test_cases = nxp_simtemp_test_cases,
+};
+
+kunit_test_suite(nxp_simtemp_test_suite);
@@ -0,0 +1,69 @@
+#include <linux/fs.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+#include <linux/limits.h>
+#include <linux/errno.h>
+
+#include "nxp_simtemp.h"
+#include "nxp_simtemp_offset.h"
+
+/**
+ * Compute where a seek lands. Offsets within an entry are aligned down to
+ * its start, seeking to the last entry latches onto the latest one.
+ * @param[in] loff Requested offset, in bytes
+ * @param[in] whence SEEK_SET, SEEK_CUR or SEEK_END
+ * @param[in] entry_idx Current entry of the handle
+ * @param[in] size Number of entries in the ring buffer
+ * @param[out] new_idx Entry the handle points to after the seek, only
+ *                     written on success
+ * @return loff_t - New file offset, or -EINVAL
+ */
+loff_t simtemp_seek(loff_t loff, int whence, u32 entry_idx, size_t size, u32 *new_idx)
+{
+        s64 idx_offset;
+        s64 new_pos;
+
+        idx_offset = div_s64(loff, sizeof(struct simtemp_sample));
+
+        /* Reject partial seek requests. Checked on the quotient, as abs()
+         * of the most negative offset overflows */
+        if ((loff != 0) && (idx_offset == 0))
+                return -EINVAL;
+
+        switch (whence) {
+        case SEEK_SET:
+                new_pos = idx_offset;
+                break;
+        case SEEK_CUR:
+                /* The latest entry is the last one of the ring */
+                new_pos = idx_offset + ((UINT_MAX == entry_idx) ? (s64)size - 1 : entry_idx);
+                break;
+        case SEEK_END:
+                new_pos = idx_offset + (s64)size - 1;
+                break;
+        default:
+                return -EINVAL;
+        }
+
+        /* Check if the new position is within entry [0, size-1] */
+        if ((new_pos < 0) || (new_pos >= (s64)size))
+                return -EINVAL;
+
+        /* If entry[size-1] is requested (e.g. by calling seek(dev, 0, SEEK_END)
+         * latch position to the last entry */
+        *new_idx = (new_pos == (s64)size - 1) ? UINT_MAX : (u32)new_pos;
+
+        return new_pos * sizeof(struct simtemp_sample);
+}
+
+/**
+ * Limit a history read to the entries available from the handle's position
+ * @param[in] count Requested number of entries
+ * @param[in] size Number of entries in the ring buffer
+ * @param[in] entry_idx Current entry of the handle, not the latest
+ * @return size_t - Number of entries that can be read
+ */
+size_t simtemp_history_count(size_t count, size_t size, u32 entry_idx)
+{
+        return min_t(size_t, count, (size > entry_idx) ? size - entry_idx : 0);
+}
@@ -0,0 +1,15 @@
+#ifndef NXP_SIMTEMP_OFFSET_H
+#define NXP_SIMTEMP_OFFSET_H
+
+#include <linux/types.h>
+
+/*
+ * File offset arithmetic of the device. Kept apart from the fops so it has
+ * no kernel dependencies beyond plain types, and builds on the host too.
+ * An entry index of UINT_MAX stands for the latest entry.
+ */
+
+loff_t simtemp_seek(loff_t loff, int whence, u32 entry_idx, size_t size, u32 *new_idx);
+size_t simtemp_history_count(size_t count, size_t size, u32 entry_idx);
+
+#endif
@@ -0,0 +1,179 @@
+#include <linux/ktime.h>
+#include <linux/wait.h>
+#include <linux/atomic.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+#include <linux/percpu.h>
+
+#include "nxp_simtemp.h"
+#include "nxp_simtemp_buffer.h"
+#include "nxp_simtemp_generators.h"
+#include "nxp_simtemp_rollup.h"
+#include "nxp_simtemp_window.h"
+#include "nxp_simtemp_alarm.h"
+#include "nxp_simtemp_debugfs.h"
+#include "nxp_simtemp_producer.h"
+
+/* Missed samples generated per batch when backfilling, 256 B of stack */
+#define BACKFILL_CHUNK_SAMPLES  16
+
+/**
+ * Validate if the sample has crossed or cleared the temperature threshold
+ * @param[in,out] simtemp_dev - Instance the sample belongs to
+ * @param[in,out]  sample - Sample to validate, might have its THRESHOLD_CROSSED
+ *                          modified, depending on the conditions
+ * @return bool - True if threshold has been crossed, False otherwise or if
+ *                hysteresis band has been cleared
+ */
+static bool validate_threshold(nxp_simtemp_dev_t *simtemp_dev,
+                               struct simtemp_sample *sample)
+{
+        const struct simtemp_params *params = &simtemp_dev->params;
+        bool retval = false;
+
+        if ((sample->temp_mC >= params->threshold_mC) && !simtemp_dev->in_threshold) {
+                simtemp_dev->in_threshold = true;
+                STAT_INC(simtemp_dev, threshold_transitions);
+        }
+        
+        if (simtemp_dev->in_threshold) {
+                if (sample->temp_mC <= (params->threshold_mC - (s32)params->hysteresis_mC)) {
+                        sample->flags &= ~THRESHOLD_CROSSED;
+                        simtemp_dev->in_threshold = false;
+                        STAT_INC(simtemp_dev, threshold_transitions);
+                } else {
+                        sample->flags |= THRESHOLD_CROSSED;
+                        retval = true;
+                }
+        }
+
+        return retval;
+}
+
+/**
+ * Push a sample from the active generator into the ring buffer
+ * @param simtemp_dev[in] Instance to produce for
+ * @param sample[in,out] Sample to push, flagged on the way
+ * @return bool - True if the sample crossed or cleared the threshold, or
+ *                changed the state of an alarm
+ */
+static bool produce_sample(nxp_simtemp_dev_t *simtemp_dev, struct simtemp_sample *sample)
+{
+        bool was_in_threshold = simtemp_dev->in_threshold;
+        u64 published;
+        u32 alarm_events;
+
+        (void)validate_threshold(simtemp_dev, sample);
+        if (ring_buffer_push(simtemp_dev->ring, sample))
+                STAT_INC(simtemp_dev, ring_overwrites);
+        published = ring_buffer_get_published(simtemp_dev->ring);
+        rollup_add(simtemp_dev->rollup, sample);
+        window_add(simtemp_dev->window, sample->temp_mC);
+        alarm_events = alarms_check(simtemp_dev->alarms, sample, published);
+        if (alarm_events)
+                STAT_ADD(simtemp_dev, alarm_events, alarm_events);
+        STAT_INC(simtemp_dev, samples_produced);
+
+        if (was_in_threshold == simtemp_dev->in_threshold)
+                return alarm_events != 0;
+
+        WRITE_ONCE(simtemp_dev->threshold_seq, published);
+        return true;
+}
+
+/**
+ * Notify consumers that new data is available, if it is enough for any of
+ * them. Waiters register the published count and time they want to be
+ * woken up at (see arm_wakeup()), so the producer only has to compare
+ * against the lowest of each, and doesn't wake anyone while nobody waits.
+ * @param simtemp_dev[in] Instance that was ticked
+ * @param now_ns[in] Monotonic time of the push
+ * @param threshold_event[in] The threshold was crossed or cleared, which
+ *                            wakes everyone up regardless of the batching
+ */
+static void notify_consumers(nxp_simtemp_dev_t *simtemp_dev, u64 now_ns,
+                             bool threshold_event)
+{
+        u64 published = ring_buffer_get_published(simtemp_dev->ring);
+
+        /* Pairs with the barrier in arm_wakeup(), either the waiter sees
+         * the new sample, or we see its registration */
+        smp_mb();
+        if (!threshold_event &&
+            (published < atomic64_read(&simtemp_dev->wake_target)) &&
+            (now_ns < atomic64_read(&simtemp_dev->wake_deadline)))
+                return;
+
+        atomic64_set(&simtemp_dev->wake_target, S64_MAX);
+        atomic64_set(&simtemp_dev->wake_deadline, S64_MAX);
+        wake_up_interruptible_sync(&simtemp_dev->wq);
+}
+
+/**
+ * Producer loop body, shared by all backends.
+ * Ticks are scheduled against absolute deadlines (epoch + n * period), so
+ * the time spent in here and the timer latency don't add up as drift. When
+ * the tick comes in after the following deadline has passed already, the
+ * deadlines in between are counted as missed and, depending on `catchup`,
+ * either skipped or backfilled with samples stamped at their deadline, up
+ * to BACKFILL_MAX_SAMPLES per tick.
+ * @param simtemp_dev[in] Instance being ticked
+ * @return ktime_t - Boot time deadline of the next tick
+ */
+ktime_t producer_tick(nxp_simtemp_dev_t *simtemp_dev)
+{
+        u64 period_ns = simtemp_dev->params.sampling_us * NSEC_PER_USEC;
+        ktime_t now = ktime_get_boottime();
+        struct simtemp_sample samples[BACKFILL_CHUNK_SAMPLES];
+        ktime_t deadline;
+        s64 lateness;
+        u64 missed = 0;
+        u64 backfill;
+        u64 now_ns;
+        unsigned int i, chunk;
+        bool threshold_event = false;
+
+        /* A new period restarts the schedule from this tick */
+        if (period_ns != simtemp_dev->tick_period_ns) {
+                simtemp_dev->tick_period_ns = period_ns;
+                simtemp_dev->tick_epoch = now;
+                simtemp_dev->tick_count = 0;
+        }
+
+        deadline = ktime_add_ns(simtemp_dev->tick_epoch, simtemp_dev->tick_count * period_ns);
+        lateness = ktime_to_ns(ktime_sub(now, deadline));
+        hist_record(simtemp_dev->tick_jitter, max_t(s64, lateness, 0));
+        if (lateness >= (s64)period_ns) {
+                missed = div64_u64(lateness, period_ns);
+                WRITE_ONCE(simtemp_dev->late_ticks, simtemp_dev->late_ticks + 1);
+                WRITE_ONCE(simtemp_dev->missed_ticks, simtemp_dev->missed_ticks + missed);
+        }
+
+        if (simtemp_catchup_backfill == simtemp_dev->params.catchup) {
+                /* A fixed bound on the time spent with bottom halves off,
+                 * e.g. after a resume, whatever the gap, the period and the
+                 * buffer_size users set */
+                backfill = min_t(u64, missed, BACKFILL_MAX_SAMPLES);
+                if (backfill < missed)
+                        STAT_ADD(simtemp_dev, backfill_skipped, missed - backfill);
+                /* Generated in chunks, see the generators' next_batch() */
+                while (backfill) {
+                        chunk = min_t(u64, backfill, BACKFILL_CHUNK_SAMPLES);
+                        get_temp_samples(samples, chunk,
+                                         ktime_add_ns(deadline, (missed - backfill) * period_ns),
+                                         period_ns, &simtemp_dev->params, &simtemp_dev->gen);
+                        for (i = 0; i < chunk; i++)
+                                threshold_event |= produce_sample(simtemp_dev, &samples[i]);
+                        backfill -= chunk;
+                }
+        }
+
+        get_temp_sample(&samples[0], now, &simtemp_dev->params, &simtemp_dev->gen);
+        threshold_event |= produce_sample(simtemp_dev, &samples[0]);
+        now_ns = ktime_get_ns();
+        WRITE_ONCE(simtemp_dev->last_push_ns, now_ns);
+        notify_consumers(simtemp_dev, now_ns, threshold_event);
+
+        simtemp_dev->tick_count += missed + 1;
+        return ktime_add_ns(simtemp_dev->tick_epoch, simtemp_dev->tick_count * period_ns);
+}
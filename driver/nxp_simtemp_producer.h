@@ -0,0 +1,14 @@
+#ifndef NXP_SIMTEMP_PRODUCER_H
+#define NXP_SIMTEMP_PRODUCER_H
+
+#include <linux/ktime.h>
+
+#include "nxp_simtemp_core.h"
+
+/* Missed samples backfilled per tick at most, the older ones are skipped */
+#define BACKFILL_MAX_SAMPLES    1024
+
+/* One tick of the producer, from a timer softirq or with bottom halves off */
+ktime_t producer_tick(nxp_simtemp_dev_t *simtemp_dev);
+
+#endif
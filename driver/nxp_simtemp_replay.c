@@ -0,0 +1,560 @@
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+#include <linux/limits.h>
+#include <linux/string.h>
+#include <linux/time64.h>
+#include <linux/errno.h>
+
+#include "nxp_simtemp_replay.h"
+
+#define REPLAY_CHUNK_MASK    (REPLAY_CHUNK_RECORDS - 1)
+/* Records per block, the most a seek walks one at a time */
+#define REPLAY_BLOCK_SHIFT   6
+#define REPLAY_BLOCK_RECORDS (1 << REPLAY_BLOCK_SHIFT)
+#define REPLAY_BLOCK_MASK    (REPLAY_BLOCK_RECORDS - 1)
+#define REPLAY_CHUNK_BLOCKS  (REPLAY_CHUNK_RECORDS >> REPLAY_BLOCK_SHIFT)
+/* Playback time is kept in 1/100 us, so the speed in percent scales it
+ * without a division */
+#define REPLAY_TIME_SCALE    100
+
+/* One sample of a trace, whatever format it was loaded from */
+struct replay_record {
+        u32 dt_us;   /* Time since the previous record, 0 for the first */
+        s32 temp_mC;
+};
+
+/*
+ * The records only hold the time since the previous one, so each chunk also
+ * keeps the playback time of the first record of every block, which lets a
+ * seek binary search the chunks, then their blocks, and walk less than a
+ * block.
+ */
+struct replay_chunk {
+        u64 marks[REPLAY_CHUNK_BLOCKS];
+        struct replay_record records[REPLAY_CHUNK_RECORDS];
+};
+
+/*
+ * Records of a trace, in chunks of REPLAY_CHUNK_RECORDS. Chunks are
+ * allocated one at a time as the trace is loaded, so even the largest trace
+ * never needs a contiguous allocation beyond a chunk and the chunk table.
+ */
+struct replay_trace {
+        struct replay_chunk **chunks;
+        u32 nchunks;
+        u32 max_chunks;   /* Room in chunks */
+        u64 count;
+        u64 end;          /* Playback time of the last record */
+        u64 period;       /* Loop length, in playback time */
+};
+
+/* Decoder of an upload in progress, fed one write at a time */
+struct replay_loader {
+        struct replay_trace *trace; /* NULL until the first write */
+        u64 offset;       /* Bytes decoded, where the next write must start */
+        bool has_header;
+        u16 format;       /* enum simtemp_trace_format */
+        /* Header or sample split across writes, a sample is the larger */
+        u8 partial[sizeof(struct simtemp_sample)];
+        u32 partial_len;
+        u64 prev_ns;      /* Samples format: timestamp of the previous record */
+        s32 prev_temp;    /* Delta format: temperature of the previous record */
+        u64 varint;       /* Delta format: varint being decoded */
+        u32 varint_shift;
+        bool has_dt;      /* Delta format: dt decoded, the change comes next */
+        u32 dt_us;
+};
+
+struct simtemp_replay {
+        spinlock_t lock;  /* Producer vs commit and readers, which take it
+                           * with bh off */
+        struct replay_trace *trace; /* Being played, NULL before the first
+                                     * commit */
+        u64 index;        /* Record being played */
+        u64 clock;        /* Playback time of the cursor */
+        u64 next_at;      /* Playback time of the record after index */
+
+        struct mutex load_lock; /* Writers of the loader */
+        struct replay_loader loader;
+};
+
+static struct replay_record *record_at(const struct replay_trace *trace, u64 index)
+{
+        return &trace->chunks[index >> REPLAY_CHUNK_SHIFT]->records[index & REPLAY_CHUNK_MASK];
+}
+
+static void free_trace(struct replay_trace *trace)
+{
+        u32 i;
+
+        if (!trace)
+                return;
+
+        for (i = 0; i < trace->nchunks; i++)
+                kvfree(trace->chunks[i]);
+        kvfree(trace->chunks);
+        kfree(trace);
+}
+
+/**
+ * Append a record, with a new chunk when the last one is full. The chunk
+ * table doubles when it runs out of room, it is 8 bytes per MiB of records.
+ * @return int - 0 on success, -EFBIG past REPLAY_RECORDS_MAX, -ENOMEM
+ */
+static int trace_append(struct replay_trace *trace, u32 dt_us, s32 temp_mC)
+{
+        struct replay_chunk **chunks;
+        struct replay_record *record;
+        u32 max_chunks;
+
+        if (trace->count == REPLAY_RECORDS_MAX)
+                return -EFBIG;
+
+        if (!(trace->count & REPLAY_CHUNK_MASK)) {
+                if (trace->nchunks == trace->max_chunks) {
+                        max_chunks = max(2 * trace->max_chunks, 16U);
+                        chunks = kvmalloc_array(max_chunks, sizeof(*chunks), GFP_KERNEL);
+                        if (!chunks)
+                                return -ENOMEM;
+                        if (trace->nchunks)
+                                memcpy(chunks, trace->chunks,
+                                       trace->nchunks * sizeof(*chunks));
+                        kvfree(trace->chunks);
+                        trace->chunks = chunks;
+                        trace->max_chunks = max_chunks;
+                }
+
+                trace->chunks[trace->nchunks] = kvmalloc(sizeof(struct replay_chunk),
+                                                         GFP_KERNEL);
+                if (!trace->chunks[trace->nchunks])
+                        return -ENOMEM;
+                trace->nchunks++;
+        }
+
+        record = record_at(trace, trace->count);
+        record->dt_us = trace->count ? dt_us : 0;
+        record->temp_mC = temp_mC;
+
+        /* The loop goes back to the first record one last interval after
+         * the last one, which is right for an evenly sampled trace */
+        trace->end += (u64)record->dt_us * REPLAY_TIME_SCALE;
+        trace->period = trace->end + (u64)record->dt_us * REPLAY_TIME_SCALE;
+        if (!(trace->count & REPLAY_BLOCK_MASK))
+                trace->chunks[trace->count >> REPLAY_CHUNK_SHIFT]->
+                        marks[(trace->count & REPLAY_CHUNK_MASK) >> REPLAY_BLOCK_SHIFT] =
+                        trace->end;
+        trace->count++;
+        return 0;
+}
+
+static void reset_loader(struct replay_loader *loader)
+{
+        free_trace(loader->trace);
+        *loader = (struct replay_loader){ 0 };
+}
+
+struct simtemp_replay *init_replay(void)
+{
+        struct simtemp_replay *replay;
+
+        replay = kzalloc(sizeof(struct simtemp_replay), GFP_KERNEL);
+        if (!replay)
+                return NULL;
+
+        spin_lock_init(&replay->lock);
+        mutex_init(&replay->load_lock);
+
+        return replay;
+}
+
+void destroy_replay(struct simtemp_replay *replay)
+{
+        if (!replay)
+                return;
+
+        reset_loader(&replay->loader);
+        free_trace(replay->trace);
+        mutex_destroy(&replay->load_lock);
+        kfree(replay);
+}
+
+static int decode_header(struct replay_loader *loader)
+{
+        struct simtemp_trace_header header;
+
+        memcpy(&header, loader->partial, sizeof(header));
+        if ((header.magic != SIMTEMP_TRACE_MAGIC) ||
+            (header.version != SIMTEMP_TRACE_VERSION) ||
+            (header.format > SIMTEMP_TRACE_DELTA))
+                return -EINVAL;
+
+        loader->format = header.format;
+        loader->has_header = true;
+        return 0;
+}
+
+static int decode_sample(struct replay_loader *loader)
+{
+        struct simtemp_sample sample;
+        u64 dt_us = 0;
+
+        memcpy(&sample, loader->partial, sizeof(sample));
+        if ((sample.temp_mC < MIN_TEMP) || (sample.temp_mC > MAX_TEMP))
+                return -EINVAL;
+
+        if (loader->trace->count) {
+                if (sample.timestamp < loader->prev_ns)
+                        return -EINVAL;
+                dt_us = div_u64(sample.timestamp - loader->prev_ns, NSEC_PER_USEC);
+        }
+        loader->prev_ns = sample.timestamp;
+
+        return trace_append(loader->trace, min_t(u64, dt_us, U32_MAX), sample.temp_mC);
+}
+
+/* A delta record is 2 varints, the dt and then the zigzag encoded change */
+static int decode_delta_field(struct replay_loader *loader, u64 value)
+{
+        s64 temp;
+
+        if (!loader->has_dt) {
+                loader->dt_us = min_t(u64, value, U32_MAX);
+                loader->has_dt = true;
+                return 0;
+        }
+
+        /* No valid change is larger than the range, nor overflows */
+        if ((value >> 1) > (u64)(MAX_TEMP - MIN_TEMP))
+                return -EINVAL;
+
+        temp = (s64)loader->prev_temp + ((s64)(value >> 1) ^ -(s64)(value & 1));
+        if ((temp < MIN_TEMP) || (temp > MAX_TEMP))
+                return -EINVAL;
+
+        loader->prev_temp = (s32)temp;
+        loader->has_dt = false;
+        return trace_append(loader->trace, loader->dt_us, (s32)temp);
+}
+
+/**
+ * Decode the next bytes of an upload. Headers and samples cut by the end of
+ * a write are kept in partial until the next one, varints in their own
+ * state.
+ * @return int - 0 on success, -EINVAL for a malformed trace, -EFBIG, -ENOMEM
+ */
+static int feed_loader(struct replay_loader *loader, const u8 *buf, size_t len)
+{
+        size_t want, take;
+        int err;
+        u8 byte;
+
+        while (len) {
+                if (loader->has_header && (SIMTEMP_TRACE_DELTA == loader->format)) {
+                        byte = *buf++;
+                        len--;
+                        /* Nothing that fits in 64 bits takes more than 10 bytes */
+                        if (loader->varint_shift >= 64)
+                                return -EINVAL;
+                        loader->varint |= (u64)(byte & 0x7f) << loader->varint_shift;
+                        loader->varint_shift += 7;
+                        if (byte & 0x80)
+                                continue;
+
+                        err = decode_delta_field(loader, loader->varint);
+                        loader->varint = 0;
+                        loader->varint_shift = 0;
+                        if (err)
+                                return err;
+                        continue;
+                }
+
+                want = loader->has_header ? sizeof(struct simtemp_sample) :
+                                            sizeof(struct simtemp_trace_header);
+                take = min(len, want - loader->partial_len);
+                memcpy(loader->partial + loader->partial_len, buf, take);
+                loader->partial_len += take;
+                buf += take;
+                len -= take;
+                if (loader->partial_len < want)
+                        break;
+
+                loader->partial_len = 0;
+                err = loader->has_header ? decode_sample(loader) : decode_header(loader);
+                if (err)
+                        return err;
+        }
+
+        return 0;
+}
+
+/**
+ * Decode a piece of a trace upload into the staged trace, see
+ * struct simtemp_trace_header for the format. The pieces must come in
+ * order, one after the other; a piece at offset 0 starts a new upload. The
+ * records are stored as they are decoded, so the trace is never held whole
+ * in its upload format. Nothing is played until replay_commit().
+ * Sleeps, must be called from process context.
+ * @param[in] replay Replay of the instance
+ * @param[in] buf Next bytes of the trace
+ * @param[in] len Size of buf
+ * @param[in] offset Position of buf in the trace
+ * @return ssize_t - len on success, or -EINVAL for an out of order piece
+ *                   or a malformed trace, -EFBIG or -ENOMEM, which all
+ *                   drop the staged trace
+ */
+ssize_t replay_load(struct simtemp_replay *replay, const void *buf, size_t len,
+                    u64 offset)
+{
+        struct replay_loader *loader = &replay->loader;
+        ssize_t retval = len;
+        int err;
+
+        mutex_lock(&replay->load_lock);
+
+        if (!offset)
+                reset_loader(loader);
+
+        if (offset != loader->offset) {
+                retval = -EINVAL;
+                goto unlock;
+        }
+
+        if (!loader->trace) {
+                loader->trace = kzalloc(sizeof(struct replay_trace), GFP_KERNEL);
+                if (!loader->trace) {
+                        retval = -ENOMEM;
+                        goto unlock;
+                }
+        }
+
+        err = feed_loader(loader, buf, len);
+        if (err) {
+                reset_loader(loader);
+                retval = err;
+                goto unlock;
+        }
+        loader->offset += len;
+
+unlock:
+        mutex_unlock(&replay->load_lock);
+        return retval;
+}
+
+/* Back to the first record, with the lock held */
+static void rewind_locked(struct simtemp_replay *replay)
+{
+        replay->index = 0;
+        replay->clock = 0;
+        replay->next_at = (replay->trace && replay->trace->count > 1) ?
+                          (u64)record_at(replay->trace, 1)->dt_us * REPLAY_TIME_SCALE : 0;
+}
+
+/**
+ * Play the staged trace from its first record on, in place of the one
+ * being played. The upload must have ended on a whole record.
+ * Sleeps, must be called from process context.
+ * @param[in] replay Replay of the instance
+ * @return int - 0 on success, -EINVAL without a complete trace staged
+ */
+int replay_commit(struct simtemp_replay *replay)
+{
+        struct replay_loader *loader = &replay->loader;
+        struct replay_trace *trace;
+
+        mutex_lock(&replay->load_lock);
+
+        if (!loader->trace || !loader->trace->count || loader->partial_len ||
+            loader->varint_shift || loader->has_dt) {
+                mutex_unlock(&replay->load_lock);
+                return -EINVAL;
+        }
+
+        trace = loader->trace;
+        loader->trace = NULL;
+        reset_loader(loader);
+
+        spin_lock_bh(&replay->lock);
+        swap(replay->trace, trace);
+        rewind_locked(replay);
+        spin_unlock_bh(&replay->lock);
+
+        mutex_unlock(&replay->load_lock);
+
+        /* The producer only touches the trace under the lock */
+        free_trace(trace);
+        return 0;
+}
+
+/**
+ * @return u64 - Records in the trace being played, 0 before the first commit
+ */
+u64 replay_get_records(struct simtemp_replay *replay)
+{
+        u64 count;
+
+        spin_lock_bh(&replay->lock);
+        count = replay->trace ? replay->trace->count : 0;
+        spin_unlock_bh(&replay->lock);
+
+        return count;
+}
+
+/**
+ * @return u64 - Index of the record being played
+ */
+u64 replay_get_position(struct simtemp_replay *replay)
+{
+        u64 index;
+
+        spin_lock_bh(&replay->lock);
+        index = replay->index;
+        spin_unlock_bh(&replay->lock);
+
+        return index;
+}
+
+/**
+ * Play the trace from its first record again
+ * @param[in] replay Replay of the instance
+ */
+void replay_rewind(struct simtemp_replay *replay)
+{
+        spin_lock_bh(&replay->lock);
+        rewind_locked(replay);
+        spin_unlock_bh(&replay->lock);
+}
+
+/* Move the cursor to the next record, with the lock held */
+static void next_record(struct simtemp_replay *replay)
+{
+        replay->index++;
+        if (replay->index + 1 < replay->trace->count)
+                replay->next_at += (u64)record_at(replay->trace, replay->index + 1)->dt_us *
+                                   REPLAY_TIME_SCALE;
+}
+
+/**
+ * Move the cursor to the latest record due at the playback time, however
+ * far it is, with the lock held. Binary searches the chunks, then the
+ * blocks of the chunk, and walks the block, so it never visits more than a
+ * few dozen records.
+ * @param[in] replay Replay of the instance, with a trace
+ */
+static void seek_locked(struct simtemp_replay *replay)
+{
+        const struct replay_trace *trace = replay->trace;
+        const struct replay_chunk *chunk;
+        u32 lo = 0, hi = trace->nchunks - 1, mid;
+        u64 index, at;
+
+        /* The first record plays at 0, so it is always due */
+        while (lo < hi) {
+                mid = (lo + hi + 1) / 2;
+                if (trace->chunks[mid]->marks[0] <= replay->clock)
+                        lo = mid;
+                else
+                        hi = mid - 1;
+        }
+        chunk = trace->chunks[lo];
+        index = (u64)lo << REPLAY_CHUNK_SHIFT;
+
+        /* Only the blocks with records have a mark */
+        lo = 0;
+        hi = (min_t(u64, trace->count - index, REPLAY_CHUNK_RECORDS) - 1) >>
+             REPLAY_BLOCK_SHIFT;
+        while (lo < hi) {
+                mid = (lo + hi + 1) / 2;
+                if (chunk->marks[mid] <= replay->clock)
+                        lo = mid;
+                else
+                        hi = mid - 1;
+        }
+        index += (u64)lo << REPLAY_BLOCK_SHIFT;
+        at = chunk->marks[lo];
+
+        replay->index = index;
+        replay->next_at = at;
+        if (index + 1 < trace->count)
+                replay->next_at += (u64)record_at(trace, index + 1)->dt_us *
+                                   REPLAY_TIME_SCALE;
+        while (replay->index + 1 < trace->count && replay->next_at <= replay->clock)
+                next_record(replay);
+}
+
+/**
+ * Temperature of the next sample of the trace. At speed 0, every sample
+ * plays the next record, whatever their timestamps. Otherwise the trace
+ * time moves by the sampling period times speed_pct / 100 per sample, and
+ * each sample plays the latest record due by then, skipping or repeating
+ * records as the rates differ. Past a block of records due at once, the
+ * cursor seeks instead of walking, so a fast speed, a slow sampling or a
+ * burst of records with the same timestamp can't keep the producer busy.
+ * Called by the producer for each sample, so from softirq context or with
+ * bottom halves disabled.
+ * @param[in] replay Replay of the instance
+ * @param[in] sampling_us Sampling period of the instance
+ * @param[in] speed_pct Playback speed, 100 for the recorded pace
+ * @param[in] loop Start over after the last record, instead of holding it
+ * @return s32 - Temperature, REPLAY_IDLE_MC while no trace is loaded
+ */
+s32 replay_next(struct simtemp_replay *replay, u64 sampling_us, u32 speed_pct,
+                bool loop)
+{
+        const struct replay_trace *trace;
+        u32 steps = 0;
+        u64 rem;
+        s32 temp;
+
+        spin_lock(&replay->lock);
+
+        trace = replay->trace;
+        if (!trace) {
+                spin_unlock(&replay->lock);
+                return REPLAY_IDLE_MC;
+        }
+
+        if (!speed_pct) {
+                temp = record_at(trace, replay->index)->temp_mC;
+                if (replay->index + 1 < trace->count) {
+                        /* Keeps the trace time in step, for a change of
+                         * speed */
+                        replay->clock = replay->next_at;
+                        next_record(replay);
+                } else if (loop) {
+                        rewind_locked(replay);
+                }
+                spin_unlock(&replay->lock);
+                return temp;
+        }
+
+        /* A whole loop or more since the last sample only divides when the
+         * playback outruns the trace */
+        if (loop && trace->period && replay->clock >= trace->period) {
+                replay->clock -= trace->period;
+                if (replay->clock >= trace->period) {
+                        (void)div64_u64_rem(replay->clock, trace->period, &rem);
+                        replay->clock = rem;
+                }
+                replay->index = 0;
+                replay->next_at = (trace->count > 1) ?
+                                  (u64)record_at(trace, 1)->dt_us * REPLAY_TIME_SCALE : 0;
+        }
+
+        while (replay->index + 1 < trace->count && replay->next_at <= replay->clock) {
+                if (++steps > REPLAY_BLOCK_RECORDS) {
+                        seek_locked(replay);
+                        break;
+                }
+                next_record(replay);
+        }
+
+        temp = record_at(trace, replay->index)->temp_mC;
+        replay->clock += sampling_us * speed_pct;
+
+        spin_unlock(&replay->lock);
+        return temp;
+}
@@ -0,0 +1,31 @@
+#ifndef NXP_SIMTEMP_REPLAY_H
+#define NXP_SIMTEMP_REPLAY_H
+
+#include <linux/types.h>
+
+#include "nxp_simtemp.h"
+
+/* Records per chunk of a trace, 1 MiB each, plus 16 KiB of block marks */
+#define REPLAY_CHUNK_SHIFT   17
+#define REPLAY_CHUNK_RECORDS (1 << REPLAY_CHUNK_SHIFT)
+/* Largest trace, 512 MiB of records, 2^26 samples or about 18 h at 1 kHz */
+#define REPLAY_RECORDS_MAX   (1ULL << 26)
+/* Played while no trace is loaded, the middle of the supported range */
+#define REPLAY_IDLE_MC       ((MIN_TEMP + MAX_TEMP) / 2)
+
+/* Loaded trace, upload state and playback cursor of an instance, opaque
+ * outside of the component */
+struct simtemp_replay;
+
+struct simtemp_replay *init_replay(void);
+void destroy_replay(struct simtemp_replay *replay);
+ssize_t replay_load(struct simtemp_replay *replay, const void *buf, size_t len,
+                    u64 offset);
+int replay_commit(struct simtemp_replay *replay);
+u64 replay_get_records(struct simtemp_replay *replay);
+u64 replay_get_position(struct simtemp_replay *replay);
+void replay_rewind(struct simtemp_replay *replay);
+s32 replay_next(struct simtemp_replay *replay, u64 sampling_us, u32 speed_pct,
+                bool loop);
+
+#endif
@@ -0,0 +1,177 @@
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+#include <linux/limits.h>
+#include <linux/time64.h>
+#include <linux/errno.h>
+
+#include "nxp_simtemp_rollup.h"
+
+/* Summary of one period, the mean is only computed when read */
+struct rollup_bucket {
+        u64 start_ns;
+        s64 sum;
+        s32 min;
+        s32 max;
+        u32 count;
+};
+
+/* Ring of the latest buckets of one tier, the newest one still open */
+struct rollup_tier {
+        struct rollup_bucket *buckets;
+        u64 width_ns;
+        u64 end_ns;   /* End of the open bucket, 0 before the first sample */
+        u32 depth;
+        u32 head;     /* Slot of the open bucket */
+        u32 len;
+};
+
+struct simtemp_rollup {
+        spinlock_t lock; /* Producer vs readers, readers take it with bh off */
+        struct rollup_tier tiers[SIMTEMP_ROLLUP_TIERS];
+};
+
+/* Must be in the same order as enum simtemp_rollup_tier */
+static const u64 tier_widths_ns[] = {
+        NSEC_PER_SEC,
+        60 * NSEC_PER_SEC,
+        3600 * NSEC_PER_SEC
+};
+
+/* Must be in the same order as enum simtemp_rollup_tier */
+static const u32 tier_depths[] = {
+        600,
+        1440,
+        720
+};
+
+struct simtemp_rollup *init_rollup(void)
+{
+        struct simtemp_rollup *rollup;
+        struct rollup_tier *tier;
+        unsigned int i;
+
+        rollup = kzalloc(sizeof(struct simtemp_rollup), GFP_KERNEL);
+        if (!rollup)
+                return NULL;
+
+        for (i = 0; i < SIMTEMP_ROLLUP_TIERS; i++) {
+                tier = &rollup->tiers[i];
+                tier->buckets = kvcalloc(tier_depths[i], sizeof(struct rollup_bucket),
+                                         GFP_KERNEL);
+                if (!tier->buckets)
+                        goto free_tiers;
+
+                tier->width_ns = tier_widths_ns[i];
+                tier->depth = tier_depths[i];
+        }
+
+        spin_lock_init(&rollup->lock);
+
+        return rollup;
+
+free_tiers:
+        while (i--)
+                kvfree(rollup->tiers[i].buckets);
+        kfree(rollup);
+        return NULL;
+}
+
+void destroy_rollup(struct simtemp_rollup *rollup)
+{
+        unsigned int i;
+
+        if (!rollup)
+                return;
+
+        for (i = 0; i < SIMTEMP_ROLLUP_TIERS; i++)
+                kvfree(rollup->tiers[i].buckets);
+        kfree(rollup);
+}
+
+/**
+ * Count a sample into the open bucket of a tier, opening a new one first if
+ * the sample belongs to a later period. Only that case needs a division.
+ */
+static void tier_add(struct rollup_tier *tier, const struct simtemp_sample *sample)
+{
+        struct rollup_bucket *bucket;
+        u64 start_ns, offset_ns;
+
+        if (sample->timestamp >= tier->end_ns) {
+                (void)div64_u64_rem(sample->timestamp, tier->width_ns, &offset_ns);
+                start_ns = sample->timestamp - offset_ns;
+                if (tier->len)
+                        tier->head = (tier->head + 1 == tier->depth) ? 0 : tier->head + 1;
+                tier->len = min(tier->len + 1, tier->depth);
+                tier->end_ns = start_ns + tier->width_ns;
+
+                bucket = &tier->buckets[tier->head];
+                bucket->start_ns = start_ns;
+                bucket->sum = 0;
+                bucket->min = S32_MAX;
+                bucket->max = S32_MIN;
+                bucket->count = 0;
+        }
+
+        bucket = &tier->buckets[tier->head];
+        bucket->sum += sample->temp_mC;
+        bucket->min = min(bucket->min, sample->temp_mC);
+        bucket->max = max(bucket->max, sample->temp_mC);
+        bucket->count++;
+}
+
+/**
+ * Count a sample into every tier. O(1), called by the producer for each
+ * sample it pushes, so from softirq context or with bottom halves disabled.
+ * Samples must come in timestamp order.
+ * @param[in] rollup Rollup of the instance
+ * @param[in] sample Sample that was just pushed
+ */
+void rollup_add(struct simtemp_rollup *rollup, const struct simtemp_sample *sample)
+{
+        unsigned int i;
+
+        spin_lock(&rollup->lock);
+        for (i = 0; i < SIMTEMP_ROLLUP_TIERS; i++)
+                tier_add(&rollup->tiers[i], sample);
+        spin_unlock(&rollup->lock);
+}
+
+/**
+ * Copy the newest buckets of a tier, oldest first.
+ * @param[in] rollup Rollup of the instance
+ * @param[in] tier enum simtemp_rollup_tier to read
+ * @param[in] count Maximum number of buckets to copy
+ * @param[out] out_buckets Room for count buckets
+ * @return int - Number of buckets copied, or -EINVAL for an unknown tier
+ */
+int rollup_read(struct simtemp_rollup *rollup, u32 tier, u32 count,
+                struct simtemp_rollup_bucket *out_buckets)
+{
+        const struct rollup_tier *t;
+        const struct rollup_bucket *bucket;
+        u32 i, len, slot;
+
+        if (tier >= SIMTEMP_ROLLUP_TIERS)
+                return -EINVAL;
+        t = &rollup->tiers[tier];
+
+        spin_lock_bh(&rollup->lock);
+        len = min(count, t->len);
+        /* The newest len buckets end at head, slot wraps around depth */
+        slot = (t->head + t->depth + 1 - len) % t->depth;
+        for (i = 0; i < len; i++) {
+                bucket = &t->buckets[slot];
+                out_buckets[i].timestamp = bucket->start_ns;
+                out_buckets[i].min_mC = bucket->min;
+                out_buckets[i].max_mC = bucket->max;
+                out_buckets[i].mean_mC = div_s64(bucket->sum, bucket->count);
+                out_buckets[i].count = bucket->count;
+                slot = (slot + 1 == t->depth) ? 0 : slot + 1;
+        }
+        spin_unlock_bh(&rollup->lock);
+
+        return len;
+}
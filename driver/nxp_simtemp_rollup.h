@@ -0,0 +1,20 @@
+#ifndef NXP_SIMTEMP_ROLLUP_H
+#define NXP_SIMTEMP_ROLLUP_H
+
+#include <linux/types.h>
+
+#include "nxp_simtemp.h"
+
+/* Deepest tier, the most buckets a read can return */
+#define ROLLUP_DEPTH_MAX 1440
+
+/* One downsampled history per instance, opaque outside of the component */
+struct simtemp_rollup;
+
+struct simtemp_rollup *init_rollup(void);
+void destroy_rollup(struct simtemp_rollup *rollup);
+void rollup_add(struct simtemp_rollup *rollup, const struct simtemp_sample *sample);
+int rollup_read(struct simtemp_rollup *rollup, u32 tier, u32 count,
+                struct simtemp_rollup_bucket *out_buckets);
+
+#endif
@@ -3,38 +3,168 @@
 #include <linux/stat.h>
 #include <linux/kernel.h>
 #include <linux/errno.h>
+#include <linux/math64.h>
+#include <linux/time64.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <linux/cpumask.h>
+#include <linux/sched/prio.h>
+#include <linux/random.h>
+#include <linux/firmware.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/sizes.h>
 
 #include "nxp_simtemp.h"
 #include "nxp_simtemp_sysfs.h"
+#include "nxp_simtemp_core.h"
+#include "nxp_simtemp_buffer.h"
+#include "nxp_simtemp_window.h"
+#include "nxp_simtemp_alarm.h"
+#include "nxp_simtemp_generators.h"
+#include "nxp_simtemp_replay.h"
 
 /* Attributes writeable by group and owner, readable by all */
 #define ATTR_PERM_RW_POLICY (S_IRUGO | S_IWUSR | S_IWGRP)
+/* Read-only attributes, readable by all */
+#define ATTR_PERM_RO_POLICY (S_IRUGO)
+/* Write-only attributes, writeable by group and owner */
+#define ATTR_PERM_WO_POLICY (S_IWUSR | S_IWGRP)
+
+/* Declares a read-only statistic attribute, all of them share stat_show() */
+#define STAT_ATTR(name)                                                        \
+        static ssize_t name##_show(struct device *dev,                         \
+                                   struct device_attribute *attr, char *buf)  \
+        {                                                                      \
+                return stat_show(dev, simtemp_stat_##name, buf);               \
+        }                                                                      \
+        DEVICE_ATTR(name, ATTR_PERM_RO_POLICY, name##_show, NULL)
+
+/* Declares a read-only attribute of the window/ directory, showing one field
+ * of struct simtemp_window */
+#define WINDOW_ATTR(field, fmt)                                                \
+        static ssize_t window_##field##_show(struct device *dev,               \
+                                             struct device_attribute *attr,    \
+                                             char *buf)                        \
+        {                                                                      \
+                nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);         \
+                struct simtemp_window window;                                  \
+                                                                               \
+                window_read(simtemp_dev->window, &window);                     \
+                return sysfs_emit(buf, fmt "\n", window.field);                \
+        }                                                                      \
+        struct device_attribute dev_attr_window_##field =                      \
+                __ATTR(field, ATTR_PERM_RO_POLICY, window_##field##_show, NULL)
+
+/* Declares the attribute of the alarms/ directory for one alarm, all of them
+ * share alarm_show() and alarm_store() */
+#define ALARM_ATTR(index)                                                      \
+        static ssize_t alarm##index##_show(struct device *dev,                 \
+                                           struct device_attribute *attr,      \
+                                           char *buf)                          \
+        {                                                                      \
+                return alarm_show(dev, index, buf);                            \
+        }                                                                      \
+        static ssize_t alarm##index##_store(struct device *dev,                \
+                                            struct device_attribute *attr,     \
+                                            const char *buf, size_t count)     \
+        {                                                                      \
+                return alarm_store(dev, index, buf, count);                    \
+        }                                                                      \
+        DEVICE_ATTR(alarm##index, ATTR_PERM_RW_POLICY, alarm##index##_show,    \
+                    alarm##index##_store)
 
 #define RAMP_PERIOD_MIN  1
 #define RAMP_PERIOD_MAX  UINT_MAX
 #define SAMPLING_RATE_MIN  1
 #define SAMPLING_RATE_MAX  UINT_MAX
+#define SAMPLING_US_MIN  10
+#define SAMPLING_US_MAX  ((u64)SAMPLING_RATE_MAX * USEC_PER_MSEC)
+#define BATCH_SAMPLES_MIN  1
+#define NOISE_OCTAVES_MIN  1
+#define PRODUCER_CPU_ANY  -1
+#define PRODUCER_PRIO_MAX  (MAX_RT_PRIO - 1)
+/* Groups before the ones of the generators in nxp_simtemp_attr_groups */
+#define FIXED_GROUPS  4
+/* Most attributes a generator's directory has besides its parameters */
+#define GEN_EXTRA_ATTRS_MAX  4
+/* Bytes of a firmware trace read at a time, see replay_firmware_store() */
+#define REPLAY_FW_CHUNK  SZ_1M
+
+/* An attribute of a generator's directory, see struct simtemp_gen_param */
+struct gen_param_attr {
+        struct device_attribute dev_attr;
+        const struct simtemp_gen_param *param;
+};
+
+/* Must be in the same order as enum simtemp_rng_mode */
+const char* rng_strings[] = {
+        "xoshiro",
+        "csprng"
+};
+
+/* Must be in the same order as enum simtemp_producer_mode */
+const char* producer_strings[] = {
+        "timer",
+        "hrtimer",
+        "kthread"
+};
+
+/* Must be in the same order as enum simtemp_catchup_mode */
+const char* catchup_strings[] = {
+        "skip",
+        "backfill"
+};
 
-/* Must be in the same order as enum simtemp_generator_mode */
-const char* mode_strings[] = {
-        "normal",
-        "noisy",
-        "ramp"
+/* Must be in the same order as enum simtemp_alarm_severity */
+const char* severity_strings[] = {
+        "warn",
+        "crit",
+        "shutdown"
 };
 
-enum simtemp_generator_mode mode = simtemp_mode_normal;
-u32 sampling_ms = 100;
-s32 ramp_min = 0;
-s32 ramp_max = 100000;
-u32 ramp_period_ms = 1000;
-s32 threshold_mC = 50000;
-u32 hysteresis_mC = 10000;
+/* Indexed by simtemp_alarm_config.falling */
+const char* direction_strings[] = {
+        "rising",
+        "falling"
+};
 
 ssize_t mode_show(struct device *dev, struct device_attribute *attr, char *buf);
 ssize_t mode_store(struct device *dev, struct device_attribute *attr,
                         const char *buf, size_t count);
 DEVICE_ATTR(mode, ATTR_PERM_RW_POLICY, mode_show, mode_store);
 
+ssize_t rng_show(struct device *dev, struct device_attribute *attr, char *buf);
+ssize_t rng_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(rng, ATTR_PERM_RW_POLICY, rng_show, rng_store);
+
+ssize_t seed_show(struct device *dev, struct device_attribute *attr, char *buf);
+ssize_t seed_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(seed, ATTR_PERM_RW_POLICY, seed_show, seed_store);
+
+ssize_t noise_octaves_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t noise_octaves_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(noise_octaves, ATTR_PERM_RW_POLICY, noise_octaves_show,
+        noise_octaves_store);
+
+ssize_t noise_amplitude_mC_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t noise_amplitude_mC_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(noise_amplitude_mC, ATTR_PERM_RW_POLICY, noise_amplitude_mC_show,
+        noise_amplitude_mC_store);
+
+ssize_t noise_speed_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t noise_speed_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(noise_speed, ATTR_PERM_RW_POLICY, noise_speed_show,
+        noise_speed_store);
+
 ssize_t sampling_ms_show(struct device *dev, struct device_attribute *attr,
         char *buf);
 ssize_t sampling_ms_store(struct device *dev, struct device_attribute *attr,
@@ -42,6 +172,80 @@ ssize_t sampling_ms_store(struct device *dev, struct device_attribute *attr,
 DEVICE_ATTR(sampling_ms, ATTR_PERM_RW_POLICY, sampling_ms_show, 
         sampling_ms_store);
 
+ssize_t sampling_us_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t sampling_us_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(sampling_us, ATTR_PERM_RW_POLICY, sampling_us_show, 
+        sampling_us_store);
+
+ssize_t batch_samples_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t batch_samples_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(batch_samples, ATTR_PERM_RW_POLICY, batch_samples_show,
+        batch_samples_store);
+
+ssize_t batch_us_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t batch_us_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(batch_us, ATTR_PERM_RW_POLICY, batch_us_show, batch_us_store);
+
+ssize_t producer_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t producer_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(producer, ATTR_PERM_RW_POLICY, producer_show, producer_store);
+
+ssize_t ondemand_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t ondemand_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(ondemand, ATTR_PERM_RW_POLICY, ondemand_show, ondemand_store);
+
+ssize_t deferrable_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t deferrable_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(deferrable, ATTR_PERM_RW_POLICY, deferrable_show,
+        deferrable_store);
+
+ssize_t producer_cpu_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t producer_cpu_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(producer_cpu, ATTR_PERM_RW_POLICY, producer_cpu_show,
+        producer_cpu_store);
+
+ssize_t producer_prio_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t producer_prio_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(producer_prio, ATTR_PERM_RW_POLICY, producer_prio_show,
+        producer_prio_store);
+
+ssize_t catchup_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t catchup_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(catchup, ATTR_PERM_RW_POLICY, catchup_show, catchup_store);
+
+ssize_t missed_ticks_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+DEVICE_ATTR(missed_ticks, ATTR_PERM_RO_POLICY, missed_ticks_show, NULL);
+
+ssize_t late_ticks_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+DEVICE_ATTR(late_ticks, ATTR_PERM_RO_POLICY, late_ticks_show, NULL);
+
+ssize_t buffer_size_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t buffer_size_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(buffer_size, ATTR_PERM_RW_POLICY, buffer_size_show,
+        buffer_size_store);
+
 ssize_t ramp_min_show(struct device *dev, struct device_attribute *attr,
         char *buf);
 ssize_t ramp_min_store(struct device *dev, struct device_attribute *attr,
@@ -77,7 +281,24 @@ DEVICE_ATTR(hysteresis_mC, ATTR_PERM_RW_POLICY, hysteresis_mC_show,
 
 static struct attribute *nxp_simtemp_attrs[] = {
         &dev_attr_mode.attr,
+        &dev_attr_rng.attr,
+        &dev_attr_seed.attr,
+        &dev_attr_noise_octaves.attr,
+        &dev_attr_noise_amplitude_mC.attr,
+        &dev_attr_noise_speed.attr,
         &dev_attr_sampling_ms.attr,
+        &dev_attr_sampling_us.attr,
+        &dev_attr_batch_samples.attr,
+        &dev_attr_batch_us.attr,
+        &dev_attr_producer.attr,
+        &dev_attr_ondemand.attr,
+        &dev_attr_deferrable.attr,
+        &dev_attr_producer_cpu.attr,
+        &dev_attr_producer_prio.attr,
+        &dev_attr_catchup.attr,
+        &dev_attr_missed_ticks.attr,
+        &dev_attr_late_ticks.attr,
+        &dev_attr_buffer_size.attr,
         &dev_attr_ramp_min.attr,
         &dev_attr_ramp_max.attr,
         &dev_attr_ramp_period_ms.attr,
@@ -90,115 +311,371 @@ static const struct attribute_group nxp_simtemp_attr_group = {
         .attrs = nxp_simtemp_attrs,
 };
 
-const struct attribute_group *nxp_simtemp_attr_groups[] = {
+static ssize_t stat_show(struct device *dev, enum simtemp_stat stat, char *buf);
+
+STAT_ATTR(samples_produced);
+STAT_ATTR(reads_served);
+STAT_ATTR(bytes_copied);
+STAT_ATTR(blocking_waits);
+STAT_ATTR(eagain_returns);
+STAT_ATTR(poll_wakeups);
+STAT_ATTR(threshold_transitions);
+STAT_ATTR(ring_overwrites);
+STAT_ATTR(samples_lost);
+STAT_ATTR(alarm_events);
+STAT_ATTR(backfill_skipped);
+
+ssize_t reset_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+DEVICE_ATTR(reset, ATTR_PERM_WO_POLICY, NULL, reset_store);
+
+static struct attribute *nxp_simtemp_stats_attrs[] = {
+        &dev_attr_samples_produced.attr,
+        &dev_attr_reads_served.attr,
+        &dev_attr_bytes_copied.attr,
+        &dev_attr_blocking_waits.attr,
+        &dev_attr_eagain_returns.attr,
+        &dev_attr_poll_wakeups.attr,
+        &dev_attr_threshold_transitions.attr,
+        &dev_attr_ring_overwrites.attr,
+        &dev_attr_samples_lost.attr,
+        &dev_attr_alarm_events.attr,
+        &dev_attr_backfill_skipped.attr,
+        &dev_attr_reset.attr,
+        NULL,
+};
+
+/* Shows up as the stats/ subdirectory of the device */
+static const struct attribute_group nxp_simtemp_stats_group = {
+        .name = "stats",
+        .attrs = nxp_simtemp_stats_attrs,
+};
+
+ssize_t window_size_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+ssize_t window_size_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+struct device_attribute dev_attr_window_size =
+        __ATTR(size, ATTR_PERM_RW_POLICY, window_size_show, window_size_store);
+
+WINDOW_ATTR(count, "%u");
+WINDOW_ATTR(min_mC, "%d");
+WINDOW_ATTR(max_mC, "%d");
+WINDOW_ATTR(mean_mC, "%d");
+WINDOW_ATTR(variance_mC2, "%llu");
+
+static struct attribute *nxp_simtemp_window_attrs[] = {
+        &dev_attr_window_size.attr,
+        &dev_attr_window_count.attr,
+        &dev_attr_window_min_mC.attr,
+        &dev_attr_window_max_mC.attr,
+        &dev_attr_window_mean_mC.attr,
+        &dev_attr_window_variance_mC2.attr,
+        NULL,
+};
+
+/* Shows up as the window/ subdirectory of the device */
+static const struct attribute_group nxp_simtemp_window_group = {
+        .name = "window",
+        .attrs = nxp_simtemp_window_attrs,
+};
+
+static ssize_t alarm_show(struct device *dev, unsigned int index, char *buf);
+static ssize_t alarm_store(struct device *dev, unsigned int index,
+        const char *buf, size_t count);
+
+/* One per SIMTEMP_ALARMS_MAX */
+ALARM_ATTR(0);
+ALARM_ATTR(1);
+ALARM_ATTR(2);
+ALARM_ATTR(3);
+ALARM_ATTR(4);
+ALARM_ATTR(5);
+ALARM_ATTR(6);
+ALARM_ATTR(7);
+
+ssize_t active_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+DEVICE_ATTR(active, ATTR_PERM_RO_POLICY, active_show, NULL);
+
+static struct attribute *nxp_simtemp_alarms_attrs[] = {
+        &dev_attr_alarm0.attr,
+        &dev_attr_alarm1.attr,
+        &dev_attr_alarm2.attr,
+        &dev_attr_alarm3.attr,
+        &dev_attr_alarm4.attr,
+        &dev_attr_alarm5.attr,
+        &dev_attr_alarm6.attr,
+        &dev_attr_alarm7.attr,
+        &dev_attr_active.attr,
+        NULL,
+};
+
+/* Shows up as the alarms/ subdirectory of the device */
+static const struct attribute_group nxp_simtemp_alarms_group = {
+        .name = "alarms",
+        .attrs = nxp_simtemp_alarms_attrs,
+};
+
+static ssize_t gen_param_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+static ssize_t gen_param_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+
+ssize_t replay_records_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+struct device_attribute dev_attr_replay_records =
+        __ATTR(records, ATTR_PERM_RO_POLICY, replay_records_show, NULL);
+
+ssize_t replay_position_show(struct device *dev, struct device_attribute *attr,
+        char *buf);
+struct device_attribute dev_attr_replay_position =
+        __ATTR(position, ATTR_PERM_RO_POLICY, replay_position_show, NULL);
+
+ssize_t replay_commit_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+struct device_attribute dev_attr_replay_commit =
+        __ATTR(commit, ATTR_PERM_WO_POLICY, NULL, replay_commit_store);
+
+ssize_t replay_firmware_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count);
+struct device_attribute dev_attr_replay_firmware =
+        __ATTR(firmware, ATTR_PERM_WO_POLICY, NULL, replay_firmware_store);
+
+ssize_t replay_trace_write(struct file *filp, struct kobject *kobj,
+        struct bin_attribute *attr, char *buf, loff_t off, size_t count);
+/* Size 0, no limit on how much can be written */
+struct bin_attribute bin_attr_replay_trace =
+        __BIN_ATTR(trace, ATTR_PERM_WO_POLICY, NULL, replay_trace_write, 0);
+
+static struct attribute *nxp_simtemp_replay_attrs[] = {
+        &dev_attr_replay_records.attr,
+        &dev_attr_replay_position.attr,
+        &dev_attr_replay_commit.attr,
+        &dev_attr_replay_firmware.attr,
+        NULL,
+};
+
+static struct bin_attribute *nxp_simtemp_replay_bin_attrs[] = {
+        &bin_attr_replay_trace,
+        NULL,
+};
+
+/* Attributes of a generator's directory besides its parameters, indexed by
+ * enum simtemp_generator_mode. At most GEN_EXTRA_ATTRS_MAX each */
+static struct attribute **gen_extra_attrs[simtemp_mode_count] = {
+        [simtemp_mode_replay] = nxp_simtemp_replay_attrs,
+};
+
+static struct bin_attribute **gen_bin_attrs[simtemp_mode_count] = {
+        [simtemp_mode_replay] = nxp_simtemp_replay_bin_attrs,
+};
+
+/* Directories of the generators with parameters, filled in by
+ * init_generator_groups() from simtemp_generators */
+static struct gen_param_attr gen_param_attrs[simtemp_mode_count][GEN_PARAMS_MAX];
+static struct attribute *gen_attrs[simtemp_mode_count][GEN_PARAMS_MAX + GEN_EXTRA_ATTRS_MAX + 1];
+static struct attribute_group gen_groups[simtemp_mode_count];
+
+/* Room for a directory per generator, the list ends at the first NULL */
+const struct attribute_group *nxp_simtemp_attr_groups[FIXED_GROUPS + simtemp_mode_count + 1] = {
         &nxp_simtemp_attr_group, 
+        &nxp_simtemp_stats_group,
+        &nxp_simtemp_window_group,
+        &nxp_simtemp_alarms_group,
         NULL
 };
 
 /************************* IMPLEMENTATION *************************/
 
+/**
+ * Set an instance's configuration to the defaults
+ * @param[out] params Configuration of the instance
+ */
+void init_params(struct simtemp_params *params)
+{
+        params->mode = simtemp_mode_normal;
+        params->rng = simtemp_rng_xoshiro;
+        /* Instances differ until a seed is written */
+        params->seed = get_random_u64();
+        params->noise_octaves = 1;
+        params->noise_amplitude_mC = MAX_TEMP - MIN_TEMP;
+        params->noise_speed = NOISE_SPEED_DEFAULT;
+        params->producer = simtemp_producer_timer;
+        params->ondemand = false;
+        params->deferrable = false;
+        params->producer_cpu = PRODUCER_CPU_ANY;
+        params->producer_prio = 0;
+        params->sampling_us = 100 * USEC_PER_MSEC;
+        params->batch_samples = 1;
+        params->batch_us = 0;
+        params->catchup = simtemp_catchup_skip;
+        params->ramp_min = 0;
+        params->ramp_max = 100000;
+        params->ramp_period_ms = 1000;
+        init_gen_params(params);
+        params->threshold_mC = 50000;
+        params->hysteresis_mC = 10000;
+}
+
 ssize_t mode_show(struct device *dev, struct device_attribute *attr, char *buf)
 {
-        return sysfs_emit(buf, "%s\n", mode_strings[mode]);
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%s\n", simtemp_generators[simtemp_dev->params.mode]->name);
 }
 
 ssize_t mode_store(struct device *dev, struct device_attribute *attr,
         const char *buf, size_t count)
 {
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        unsigned int mode;
+
+        for (mode = 0; mode < simtemp_mode_count; mode++) {
+                if (sysfs_streq(buf, simtemp_generators[mode]->name)) {
+                        simtemp_dev->params.mode = mode;
+                        return count;
+                }
+        }
+
+        return -EINVAL;
+}
+
+ssize_t rng_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%s\n", rng_strings[simtemp_dev->params.rng]);
+}
+
+ssize_t rng_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
         int retval;
 
-        retval =  sysfs_match_string(mode_strings, buf);
+        retval = sysfs_match_string(rng_strings, buf);
         if (retval < 0)
                 return retval;
-        
-        mode = retval;
+
+        simtemp_dev->params.rng = retval;
         return count;
 }
 
-ssize_t sampling_ms_show(struct device *dev, struct device_attribute *attr,
+ssize_t seed_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%llu\n", simtemp_dev->params.seed);
+}
+
+ssize_t seed_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        u64 input;
+        int retval;
+
+        retval = kstrtou64(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        /* Writing the same seed again replays the same sequence */
+        reseed_producer(simtemp_dev, input);
+        return count;
+}
+
+ssize_t noise_octaves_show(struct device *dev, struct device_attribute *attr,
         char *buf)
 {
-        return sysfs_emit(buf, "%d\n", sampling_ms);
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%u\n", simtemp_dev->params.noise_octaves);
 }
 
-ssize_t sampling_ms_store(struct device *dev, struct device_attribute *attr,
+ssize_t noise_octaves_store(struct device *dev, struct device_attribute *attr,
         const char *buf, size_t count)
 {
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
         uint input;
         int retval;
 
         retval = kstrtouint(buf, 0, &input);
-        if (retval) 
+        if (retval)
                 return retval;
 
-        if ((input < SAMPLING_RATE_MIN) || (input > SAMPLING_RATE_MAX))
+        if ((input < NOISE_OCTAVES_MIN) || (input > NOISE_OCTAVES_MAX))
                 return -ERANGE;
-        
-        sampling_ms = input;
+
+        simtemp_dev->params.noise_octaves = input;
         return count;
 }
 
-ssize_t ramp_min_show(struct device *dev, struct device_attribute *attr, 
+ssize_t noise_amplitude_mC_show(struct device *dev, struct device_attribute *attr,
         char *buf)
 {
-        return sysfs_emit(buf, "%d\n", ramp_min);
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%u\n", simtemp_dev->params.noise_amplitude_mC);
 }
 
-ssize_t ramp_min_store(struct device *dev, struct device_attribute *attr,
+ssize_t noise_amplitude_mC_store(struct device *dev, struct device_attribute *attr,
         const char *buf, size_t count)
 {
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        uint input;
         int retval;
-        int input;
 
-        retval = kstrtoint(buf, 0, &input);
+        retval = kstrtouint(buf, 0, &input);
         if (retval)
                 return retval;
 
-        if ((input < MIN_TEMP) || (input > MAX_TEMP))
+        if (input > (MAX_TEMP - MIN_TEMP))
                 return -ERANGE;
 
-        if (input > ramp_max)
-                return -EINVAL;
-        
-        ramp_min = input;
+        simtemp_dev->params.noise_amplitude_mC = input;
         return count;
 }
 
-ssize_t ramp_max_show(struct device *dev, struct device_attribute *attr,
+ssize_t noise_speed_show(struct device *dev, struct device_attribute *attr,
         char *buf)
 {
-        return sysfs_emit(buf, "%d\n", ramp_max);
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%u\n", simtemp_dev->params.noise_speed);
 }
 
-ssize_t ramp_max_store(struct device *dev, struct device_attribute *attr,
+ssize_t noise_speed_store(struct device *dev, struct device_attribute *attr,
         const char *buf, size_t count)
 {
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        uint input;
         int retval;
-        int input;
 
-        retval = kstrtoint(buf, 0, &input);
+        retval = kstrtouint(buf, 0, &input);
         if (retval)
                 return retval;
 
-        if ((input < MIN_TEMP) || (input > MAX_TEMP))
-                return -ERANGE;
-
-        if (input < ramp_min)
-                return -EINVAL;
-        
-        ramp_max = input;
+        /* Any value, 0 holds the curve still */
+        simtemp_dev->params.noise_speed = input;
         return count;
 }
 
-ssize_t ramp_period_ms_show(struct device *dev, struct device_attribute *attr,
-                        char *buf)
+ssize_t sampling_ms_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
 {
-        return sysfs_emit(buf, "%d\n", ramp_period_ms);        
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        /* Rounded up, so a sub-ms period reads as 1 and any value shown
+         * can be written back */
+        return sysfs_emit(buf, "%llu\n",
+                          DIV_ROUND_UP_ULL(simtemp_dev->params.sampling_us, USEC_PER_MSEC));
 }
 
-ssize_t ramp_period_ms_store(struct device *dev, struct device_attribute *attr,
+ssize_t sampling_ms_store(struct device *dev, struct device_attribute *attr,
         const char *buf, size_t count)
-{ 
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
         uint input;
         int retval;
 
@@ -206,65 +683,741 @@ ssize_t ramp_period_ms_store(struct device *dev, struct device_attribute *attr,
         if (retval) 
                 return retval;
 
-        if ((input < RAMP_PERIOD_MIN) || (input > RAMP_PERIOD_MAX))
+        if ((input < SAMPLING_RATE_MIN) || (input > SAMPLING_RATE_MAX))
                 return -ERANGE;
         
-        ramp_period_ms = input;
+        simtemp_dev->params.sampling_us = (u64)input * USEC_PER_MSEC;
         return count;
 }
 
-ssize_t threshold_mC_show(struct device *dev, struct device_attribute *attr,
-                        char *buf)
+ssize_t sampling_us_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
 {
-        return sysfs_emit(buf, "%d\n", threshold_mC);
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%llu\n", simtemp_dev->params.sampling_us);
 }
 
-ssize_t threshold_mC_store(struct device *dev, struct device_attribute *attr,
+ssize_t sampling_us_store(struct device *dev, struct device_attribute *attr,
         const char *buf, size_t count)
 {
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        u64 input;
         int retval;
-        int input;
-        int hys_band;
 
-        retval = kstrtoint(buf, 0, &input);
-        if (retval)
+        retval = kstrtou64(buf, 0, &input);
+        if (retval) 
                 return retval;
 
-        if ((input < MIN_TEMP) || (input > MAX_TEMP))
+        if ((input < SAMPLING_US_MIN) || (input > SAMPLING_US_MAX))
                 return -ERANGE;
+        
+        simtemp_dev->params.sampling_us = input;
+        return count;
+}
 
-        hys_band = input - hysteresis_mC;
-        if ((hys_band < MIN_TEMP) || (hys_band > MAX_TEMP))
-                return -EINVAL;
+ssize_t batch_samples_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%u\n", simtemp_dev->params.batch_samples);
+}
+
+ssize_t batch_samples_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        uint input;
+        int retval;
+
+        retval = kstrtouint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if (input < BATCH_SAMPLES_MIN)
+                return -ERANGE;
 
-        threshold_mC = input;
+        /* Only a default, handles keep what they were opened with */
+        simtemp_dev->params.batch_samples = input;
         return count;
 }
 
-ssize_t hysteresis_mC_show(struct device *dev, struct device_attribute *attr, 
-                        char *buf)
+ssize_t batch_us_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
 {
-        return sysfs_emit(buf, "%d\n", hysteresis_mC);
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%u\n", simtemp_dev->params.batch_us);
 }
 
-ssize_t hysteresis_mC_store(struct device *dev, struct device_attribute *attr,
+ssize_t batch_us_store(struct device *dev, struct device_attribute *attr,
         const char *buf, size_t count)
 {
-        int retval;
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
         uint input;
-        int hys_band;
+        int retval;
 
         retval = kstrtouint(buf, 0, &input);
         if (retval)
                 return retval;
 
-        if (input > (MAX_TEMP - MIN_TEMP))
-                return -ERANGE;
+        simtemp_dev->params.batch_us = input;
+        return count;
+}
 
-        hys_band = threshold_mC - input;
-        if ((hys_band < MIN_TEMP) || (hys_band > MAX_TEMP))
-                return -EINVAL;
+ssize_t producer_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%s\n", producer_strings[simtemp_dev->params.producer]);
+}
+
+ssize_t producer_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        int retval;
+
+        retval = sysfs_match_string(producer_strings, buf);
+        if (retval < 0)
+                return retval;
+
+        /* The core swaps the backends over, as one has to be stopped first */
+        simtemp_dev->params.producer = retval;
+        restart_producer(simtemp_dev);
+        return count;
+}
 
-        hysteresis_mC = input;
+ssize_t ondemand_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%d\n", simtemp_dev->params.ondemand);
+}
+
+ssize_t ondemand_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        bool input;
+        int retval;
+
+        retval = kstrtobool(buf, &input);
+        if (retval)
+                return retval;
+
+        /* The core parks or starts the producer, depending on the consumers */
+        simtemp_dev->params.ondemand = input;
+        restart_producer(simtemp_dev);
         return count;
 }
+
+ssize_t deferrable_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%d\n", simtemp_dev->params.deferrable);
+}
+
+ssize_t deferrable_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        bool input;
+        int retval;
+
+        retval = kstrtobool(buf, &input);
+        if (retval)
+                return retval;
+
+        simtemp_dev->params.deferrable = input;
+        /* The flag is set up when the timer is armed, the others ignore it */
+        if (simtemp_producer_timer == simtemp_dev->params.producer)
+                restart_producer(simtemp_dev);
+        return count;
+}
+
+ssize_t producer_cpu_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%d\n", simtemp_dev->params.producer_cpu);
+}
+
+ssize_t producer_cpu_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        int retval;
+        int input;
+
+        retval = kstrtoint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if ((input != PRODUCER_CPU_ANY) &&
+            ((input < 0) || (input >= nr_cpu_ids) || !cpu_possible(input)))
+                return -ERANGE;
+
+        simtemp_dev->params.producer_cpu = input;
+        /* Only the kthread is placed, the timers run where they were armed */
+        if (simtemp_producer_kthread == simtemp_dev->params.producer)
+                restart_producer(simtemp_dev);
+        return count;
+}
+
+ssize_t producer_prio_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%u\n", simtemp_dev->params.producer_prio);
+}
+
+ssize_t producer_prio_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        uint input;
+        int retval;
+
+        retval = kstrtouint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if (input > PRODUCER_PRIO_MAX)
+                return -ERANGE;
+
+        simtemp_dev->params.producer_prio = input;
+        if (simtemp_producer_kthread == simtemp_dev->params.producer)
+                restart_producer(simtemp_dev);
+        return count;
+}
+
+ssize_t catchup_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%s\n", catchup_strings[simtemp_dev->params.catchup]);
+}
+
+ssize_t catchup_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        int retval;
+
+        retval = sysfs_match_string(catchup_strings, buf);
+        if (retval < 0)
+                return retval;
+
+        simtemp_dev->params.catchup = retval;
+        return count;
+}
+
+ssize_t missed_ticks_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%llu\n", READ_ONCE(simtemp_dev->missed_ticks));
+}
+
+ssize_t late_ticks_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%llu\n", READ_ONCE(simtemp_dev->late_ticks));
+}
+
+ssize_t buffer_size_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%zu\n", get_ring_buffer_capacity(simtemp_dev->ring));
+}
+
+ssize_t buffer_size_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        unsigned long input;
+        int retval;
+
+        retval = kstrtoul(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        /* Rounded up to a power of 2, keeps the newest samples that fit */
+        retval = ring_buffer_resize(simtemp_dev->ring, input);
+        if (retval)
+                return retval;
+
+        return count;
+}
+
+ssize_t ramp_min_show(struct device *dev, struct device_attribute *attr, 
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%d\n", simtemp_dev->params.ramp_min);
+}
+
+ssize_t ramp_min_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        int retval;
+        int input;
+
+        retval = kstrtoint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if ((input < MIN_TEMP) || (input > MAX_TEMP))
+                return -ERANGE;
+
+        if (input > simtemp_dev->params.ramp_max)
+                return -EINVAL;
+        
+        simtemp_dev->params.ramp_min = input;
+        return count;
+}
+
+ssize_t ramp_max_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%d\n", simtemp_dev->params.ramp_max);
+}
+
+ssize_t ramp_max_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        int retval;
+        int input;
+
+        retval = kstrtoint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if ((input < MIN_TEMP) || (input > MAX_TEMP))
+                return -ERANGE;
+
+        if (input < simtemp_dev->params.ramp_min)
+                return -EINVAL;
+        
+        simtemp_dev->params.ramp_max = input;
+        return count;
+}
+
+ssize_t ramp_period_ms_show(struct device *dev, struct device_attribute *attr,
+                        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%d\n", simtemp_dev->params.ramp_period_ms);        
+}
+
+ssize_t ramp_period_ms_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        uint input;
+        int retval;
+
+        retval = kstrtouint(buf, 0, &input);
+        if (retval) 
+                return retval;
+
+        if ((input < RAMP_PERIOD_MIN) || (input > RAMP_PERIOD_MAX))
+                return -ERANGE;
+        
+        simtemp_dev->params.ramp_period_ms = input;
+        return count;
+}
+
+ssize_t threshold_mC_show(struct device *dev, struct device_attribute *attr,
+                        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%d\n", simtemp_dev->params.threshold_mC);
+}
+
+ssize_t threshold_mC_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        int retval;
+        int input;
+        int hys_band;
+
+        retval = kstrtoint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if ((input < MIN_TEMP) || (input > MAX_TEMP))
+                return -ERANGE;
+
+        hys_band = input - simtemp_dev->params.hysteresis_mC;
+        if ((hys_band < MIN_TEMP) || (hys_band > MAX_TEMP))
+                return -EINVAL;
+
+        simtemp_dev->params.threshold_mC = input;
+        return count;
+}
+
+ssize_t hysteresis_mC_show(struct device *dev, struct device_attribute *attr, 
+                        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%d\n", simtemp_dev->params.hysteresis_mC);
+}
+
+ssize_t hysteresis_mC_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        int retval;
+        uint input;
+        int hys_band;
+
+        retval = kstrtouint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if (input > (MAX_TEMP - MIN_TEMP))
+                return -ERANGE;
+
+        hys_band = simtemp_dev->params.threshold_mC - input;
+        if ((hys_band < MIN_TEMP) || (hys_band > MAX_TEMP))
+                return -EINVAL;
+
+        simtemp_dev->params.hysteresis_mC = input;
+        return count;
+}
+
+/**
+ * Sum a statistic over all CPUs and print it
+ * @return ssize_t - Number of bytes written to buf
+ */
+static ssize_t stat_show(struct device *dev, enum simtemp_stat stat, char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        u64 sum = 0;
+        int cpu;
+
+        for_each_possible_cpu(cpu)
+                sum += per_cpu_ptr(simtemp_dev->stats, cpu)->count[stat];
+
+        return sysfs_emit(buf, "%llu\n", sum);
+}
+
+ssize_t reset_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        bool input;
+        int retval;
+        int cpu;
+
+        retval = kstrtobool(buf, &input);
+        if (retval)
+                return retval;
+
+        if (!input)
+                return count;
+
+        /* Not atomic against counting on other CPUs, an increment racing
+         * with the reset may survive it */
+        for_each_possible_cpu(cpu)
+                memset(per_cpu_ptr(simtemp_dev->stats, cpu), 0, sizeof(struct simtemp_stats));
+
+        return count;
+}
+
+ssize_t window_size_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        struct simtemp_window window;
+
+        window_read(simtemp_dev->window, &window);
+        return sysfs_emit(buf, "%u\n", window.size);
+}
+
+ssize_t window_size_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        uint input;
+        int retval;
+
+        retval = kstrtouint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if ((input < WINDOW_SIZE_MIN) || (input > WINDOW_SIZE_MAX))
+                return -ERANGE;
+
+        /* The window starts over empty */
+        retval = window_resize(simtemp_dev->window, input);
+        if (retval)
+                return retval;
+
+        return count;
+}
+
+/**
+ * Print an alarm's configuration, in the format alarm_store() takes
+ * @return ssize_t - Number of bytes written to buf
+ */
+static ssize_t alarm_show(struct device *dev, unsigned int index, char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        struct simtemp_alarm_config config;
+
+        alarms_get_config(simtemp_dev->alarms, index, &config);
+        if (!config.enabled)
+                return sysfs_emit(buf, "off\n");
+
+        return sysfs_emit(buf, "%s %s %d %u\n", severity_strings[config.severity],
+                          direction_strings[config.falling], config.threshold_mC,
+                          config.hysteresis_mC);
+}
+
+/**
+ * Configure an alarm from "<severity> <direction> <threshold_mC> <hysteresis_mC>",
+ * e.g. "crit rising 90000 2000", or disable it with "off"
+ * @return ssize_t - count on success, negative errno otherwise
+ */
+static ssize_t alarm_store(struct device *dev, unsigned int index,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        struct simtemp_alarm_config config;
+        char severity[16], direction[16];
+        int retval;
+
+        if (sysfs_streq(buf, "off")) {
+                alarms_get_config(simtemp_dev->alarms, index, &config);
+                config.enabled = false;
+                alarms_set_config(simtemp_dev->alarms, index, &config);
+                return count;
+        }
+
+        if (sscanf(buf, "%15s %15s %d %u", severity, direction,
+                   &config.threshold_mC, &config.hysteresis_mC) != 4)
+                return -EINVAL;
+
+        retval = match_string(severity_strings, ARRAY_SIZE(severity_strings), severity);
+        if (retval < 0)
+                return retval;
+        config.severity = retval;
+
+        retval = match_string(direction_strings, ARRAY_SIZE(direction_strings), direction);
+        if (retval < 0)
+                return retval;
+        config.falling = retval;
+
+        if ((config.threshold_mC < MIN_TEMP) || (config.threshold_mC > MAX_TEMP) ||
+            (config.hysteresis_mC > (MAX_TEMP - MIN_TEMP)))
+                return -ERANGE;
+
+        config.enabled = true;
+        alarms_set_config(simtemp_dev->alarms, index, &config);
+        return count;
+}
+
+ssize_t active_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "0x%02x\n", alarms_get_active(simtemp_dev->alarms));
+}
+
+static ssize_t gen_param_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        const struct simtemp_gen_param *param =
+                container_of(attr, struct gen_param_attr, dev_attr)->param;
+
+        return sysfs_emit(buf, "%d\n",
+                          *(s32 *)((u8 *)&simtemp_dev->params + param->offset));
+}
+
+static ssize_t gen_param_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        const struct simtemp_gen_param *param =
+                container_of(attr, struct gen_param_attr, dev_attr)->param;
+        int input;
+        int retval;
+
+        retval = kstrtoint(buf, 0, &input);
+        if (retval)
+                return retval;
+
+        if ((input < param->min) || (input > param->max))
+                return -ERANGE;
+
+        /* Picked up by the generator on its next sample */
+        *(s32 *)((u8 *)&simtemp_dev->params + param->offset) = input;
+        return count;
+}
+
+/**
+ * Build the sysfs directory of each generator with parameters or extra
+ * attributes, named after it, and add it to nxp_simtemp_attr_groups. Must
+ * be called once, before the class is registered.
+ */
+void init_generator_groups(void)
+{
+        const struct simtemp_generator_ops *ops;
+        struct gen_param_attr *param_attr;
+        struct attribute **extra;
+        unsigned int mode, i, ngroups = FIXED_GROUPS;
+
+        for (mode = 0; mode < simtemp_mode_count; mode++) {
+                ops = simtemp_generators[mode];
+                for (i = 0; i < GEN_PARAMS_MAX && ops->params[i].name; i++) {
+                        param_attr = &gen_param_attrs[mode][i];
+                        param_attr->param = &ops->params[i];
+                        param_attr->dev_attr.attr.name = ops->params[i].name;
+                        param_attr->dev_attr.attr.mode = ATTR_PERM_RW_POLICY;
+                        param_attr->dev_attr.show = gen_param_show;
+                        param_attr->dev_attr.store = gen_param_store;
+                        gen_attrs[mode][i] = &param_attr->dev_attr.attr;
+                }
+                for (extra = gen_extra_attrs[mode]; extra && *extra; extra++)
+                        gen_attrs[mode][i++] = *extra;
+                if (!i && !gen_bin_attrs[mode])
+                        continue;
+
+                gen_attrs[mode][i] = NULL;
+                gen_groups[mode].name = ops->name;
+                gen_groups[mode].attrs = gen_attrs[mode];
+                gen_groups[mode].bin_attrs = gen_bin_attrs[mode];
+                nxp_simtemp_attr_groups[ngroups++] = &gen_groups[mode];
+        }
+
+        nxp_simtemp_attr_groups[ngroups] = NULL;
+}
+
+ssize_t replay_records_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%llu\n", replay_get_records(simtemp_dev->replay));
+}
+
+ssize_t replay_position_show(struct device *dev, struct device_attribute *attr,
+        char *buf)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+
+        return sysfs_emit(buf, "%llu\n", replay_get_position(simtemp_dev->replay));
+}
+
+ssize_t replay_commit_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        bool input;
+        int retval;
+
+        retval = kstrtobool(buf, &input);
+        if (retval)
+                return retval;
+
+        if (!input)
+                return count;
+
+        retval = replay_commit(simtemp_dev->replay);
+        if (retval)
+                return retval;
+
+        return count;
+}
+
+ssize_t replay_trace_write(struct file *filp, struct kobject *kobj,
+        struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(kobj_to_dev(kobj));
+
+        /* sysfs hands the upload over a page at a time, in order */
+        return replay_load(simtemp_dev->replay, buf, count, off);
+}
+
+/**
+ * Load a trace from /lib/firmware and play it. It is read REPLAY_FW_CHUNK
+ * bytes at a time into the same buffer, and decoded as it comes, so the
+ * file is never in memory whole.
+ */
+ssize_t replay_firmware_store(struct device *dev, struct device_attribute *attr,
+        const char *buf, size_t count)
+{
+        nxp_simtemp_dev_t *simtemp_dev = dev_get_drvdata(dev);
+        const struct firmware *fw;
+        size_t offset = 0, len;
+        ssize_t loaded;
+        char *name;
+        void *chunk;
+        int retval;
+
+        name = kstrndup(buf, count, GFP_KERNEL);
+        if (!name)
+                return -ENOMEM;
+
+        chunk = kvmalloc(REPLAY_FW_CHUNK, GFP_KERNEL);
+        if (!chunk) {
+                retval = -ENOMEM;
+                goto free_name;
+        }
+
+        do {
+                retval = request_partial_firmware_into_buf(&fw, strim(name), dev, chunk,
+                                                           REPLAY_FW_CHUNK, offset);
+                /* Reading at the end of a file that is a whole number of
+                 * chunks fails instead of returning nothing */
+                if (retval == -EINVAL && offset)
+                        break;
+                if (retval)
+                        goto free_chunk;
+
+                len = fw->size;
+                release_firmware(fw);
+
+                loaded = replay_load(simtemp_dev->replay, chunk, len, offset);
+                if (loaded < 0) {
+                        retval = loaded;
+                        goto free_chunk;
+                }
+                offset += len;
+        } while (len == REPLAY_FW_CHUNK);
+
+        retval = replay_commit(simtemp_dev->replay);
+
+free_chunk:
+        kvfree(chunk);
+free_name:
+        kfree(name);
+        return retval ? retval : count;
+}
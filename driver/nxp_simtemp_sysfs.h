@@ -3,21 +3,107 @@
 
 #include <linux/types.h>
 
-/* Signal Generator modes */
+/* Signal Generator modes, see simtemp_generators for their names */
 enum simtemp_generator_mode{
     simtemp_mode_normal,
     simtemp_mode_noisy,
-    simtemp_mode_ramp
+    simtemp_mode_ramp,
+    simtemp_mode_sine,
+    simtemp_mode_square,
+    simtemp_mode_walk,
+    simtemp_mode_thermal,
+    simtemp_mode_replay,
+    simtemp_mode_count
 };
 
-extern enum simtemp_generator_mode mode;
-extern u32 sampling_ms;
-extern s32 ramp_min;
-extern s32 ramp_max;
-extern u32 ramp_period_ms;
-extern s32 threshold_mC;
-extern u32 hysteresis_mC;
+/* Producer backends driving the sampling loop */
+enum simtemp_producer_mode {
+    simtemp_producer_timer,
+    simtemp_producer_hrtimer,
+    simtemp_producer_kthread
+};
+
+/* What the producer does about ticks it missed. Backfill covers the latest
+ * BACKFILL_MAX_SAMPLES (1024) of them per tick, the older ones are counted
+ * in backfill_skipped and skipped */
+enum simtemp_catchup_mode {
+    simtemp_catchup_skip,
+    simtemp_catchup_backfill
+};
+
+/* Random source of the noisy generator */
+enum simtemp_rng_mode {
+    simtemp_rng_xoshiro,
+    simtemp_rng_csprng
+};
+
+/* Per-instance configuration, as set through the sysfs attributes */
+struct simtemp_params {
+    enum simtemp_generator_mode mode;
+    enum simtemp_rng_mode rng;
+    u64 seed;           /* Latest seed of the generators */
+    u32 noise_octaves;  /* Normal: octaves of the fractal noise */
+    u32 noise_amplitude_mC; /* Normal: peak to peak, centered in the range */
+    u32 noise_speed;    /* Normal: table position increment per sample */
+    enum simtemp_producer_mode producer;
+    bool ondemand;      /* Only tick while the device is open */
+    bool deferrable;    /* The timer backend doesn't wake idle CPUs */
+    s32 producer_cpu;   /* CPU the kthread producer is bound to, -1 for any */
+    u32 producer_prio;  /* SCHED_FIFO priority of the kthread, 0 for normal */
+    u64 sampling_us;
+    u32 batch_samples;  /* Default wakeup batching of new handles */
+    u32 batch_us;
+    enum simtemp_catchup_mode catchup;
+    s32 ramp_min;
+    s32 ramp_max;
+    u32 ramp_period_ms;
+    s32 sine_period_ms;     /* Sine: sine/ directory */
+    s32 sine_amplitude_mC;  /* Sine: peak, around the offset */
+    s32 sine_offset_mC;
+    s32 square_low_mC;      /* Square: square/ directory */
+    s32 square_high_mC;
+    s32 square_period_ms;
+    s32 square_duty_pct;    /* Square: share of the period spent high */
+    s32 walk_step_mC;       /* Walk: walk/ directory, largest step */
+    s32 walk_min_mC;        /* Walk: bounds it bounces off */
+    s32 walk_max_mC;
+    s32 thermal_ambient_mC; /* Thermal: thermal/ directory, cooling target */
+    s32 thermal_heated_mC;  /* Thermal: heating target */
+    s32 thermal_tau_ms;     /* Thermal: time constant */
+    s32 thermal_period_ms;  /* Thermal: heating then cooling, half each */
+    s32 replay_speed_pct;   /* Replay: replay/ directory, 0 for a record per
+                             * sample */
+    s32 replay_loop;        /* Replay: start over after the last record */
+    s32 threshold_mC;
+    u32 hysteresis_mC;
+};
+
+void init_params(struct simtemp_params *params);
+
+/* Runtime statistics, see nxp_simtemp_stats_attrs for their sysfs names */
+enum simtemp_stat {
+    simtemp_stat_samples_produced,
+    simtemp_stat_reads_served,
+    simtemp_stat_bytes_copied,
+    simtemp_stat_blocking_waits,
+    simtemp_stat_eagain_returns,
+    simtemp_stat_poll_wakeups,
+    simtemp_stat_threshold_transitions,
+    simtemp_stat_ring_overwrites,
+    simtemp_stat_samples_lost,
+    simtemp_stat_alarm_events,
+    simtemp_stat_backfill_skipped,
+    simtemp_stat_count
+};
+
+/* Kept per CPU, so counting on the hot paths never bounces a cacheline.
+ * Summed over all CPUs when shown */
+struct simtemp_stats {
+    u64 count[simtemp_stat_count];
+};
 
 extern const struct attribute_group *nxp_simtemp_attr_groups[];
 
+void init_generator_groups(void);
+
 #endif
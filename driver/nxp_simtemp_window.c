@@ -0,0 +1,233 @@
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+#include <linux/errno.h>
+
+#include "nxp_simtemp_window.h"
+
+/* Candidate for the min or max, seq is the window sequence of its sample */
+struct window_entry {
+        u32 seq;
+        s32 value;
+};
+
+/*
+ * Monotonic deque: values only grow (min) or shrink (max) from front to back,
+ * so the front is always the min or max of the window. Ring of size slots.
+ */
+struct window_deque {
+        struct window_entry *entries;
+        u32 head;
+        u32 len;
+};
+
+struct sliding_window {
+        spinlock_t lock; /* Producer vs readers, readers take it with bh off */
+        s32 *values;     /* Ring of the last size values */
+        struct window_deque min_q;
+        struct window_deque max_q;
+        s64 sum;
+        u64 sum_sq;
+        u32 size;
+        u32 head;        /* Slot of the next value */
+        u32 count;
+        u32 seq;         /* Values added, wraps around */
+};
+
+static int alloc_storage(u32 size, s32 **values, struct window_entry **min_entries,
+                         struct window_entry **max_entries)
+{
+        *values = kvcalloc(size, sizeof(s32), GFP_KERNEL);
+        *min_entries = kvcalloc(size, sizeof(struct window_entry), GFP_KERNEL);
+        *max_entries = kvcalloc(size, sizeof(struct window_entry), GFP_KERNEL);
+        if (!*values || !*min_entries || !*max_entries) {
+                kvfree(*values);
+                kvfree(*min_entries);
+                kvfree(*max_entries);
+                return -ENOMEM;
+        }
+
+        return 0;
+}
+
+static void reset_window(struct sliding_window *window)
+{
+        window->min_q.head = 0;
+        window->min_q.len = 0;
+        window->max_q.head = 0;
+        window->max_q.len = 0;
+        window->sum = 0;
+        window->sum_sq = 0;
+        window->head = 0;
+        window->count = 0;
+        window->seq = 0;
+}
+
+struct sliding_window *init_window(u32 size)
+{
+        struct sliding_window *window;
+
+        if (size < WINDOW_SIZE_MIN || size > WINDOW_SIZE_MAX)
+                return NULL;
+
+        window = kzalloc(sizeof(struct sliding_window), GFP_KERNEL);
+        if (!window)
+                return NULL;
+
+        if (alloc_storage(size, &window->values, &window->min_q.entries,
+                          &window->max_q.entries)) {
+                kfree(window);
+                return NULL;
+        }
+
+        window->size = size;
+        spin_lock_init(&window->lock);
+
+        return window;
+}
+
+void destroy_window(struct sliding_window *window)
+{
+        if (!window)
+                return;
+
+        kvfree(window->values);
+        kvfree(window->min_q.entries);
+        kvfree(window->max_q.entries);
+        kfree(window);
+}
+
+/**
+ * Change the window length. The aggregates start over from an empty window.
+ * @param[in] window Window of the instance
+ * @param[in] size New length, in samples
+ * @return int - 0 on success, -EINVAL for an out of range size, -ENOMEM
+ */
+int window_resize(struct sliding_window *window, u32 size)
+{
+        struct window_entry *min_entries, *max_entries;
+        s32 *values;
+        int err;
+
+        if (size < WINDOW_SIZE_MIN || size > WINDOW_SIZE_MAX)
+                return -EINVAL;
+
+        err = alloc_storage(size, &values, &min_entries, &max_entries);
+        if (err)
+                return err;
+
+        spin_lock_bh(&window->lock);
+        swap(window->values, values);
+        swap(window->min_q.entries, min_entries);
+        swap(window->max_q.entries, max_entries);
+        window->size = size;
+        reset_window(window);
+        spin_unlock_bh(&window->lock);
+
+        kvfree(values);
+        kvfree(min_entries);
+        kvfree(max_entries);
+
+        return 0;
+}
+
+/**
+ * Drop the front entries that left the window, then the back entries the new
+ * value makes useless, and append it. Each entry is appended and dropped once,
+ * so it is O(1) amortized.
+ * @param[in] q Deque to update
+ * @param[in] size Window length, also the ring size of the deque
+ * @param[in] seq Sequence of the new value
+ * @param[in] value New value
+ * @param[in] is_max Keep the max at the front instead of the min
+ */
+static void deque_push(struct window_deque *q, u32 size, u32 seq, s32 value, bool is_max)
+{
+        const struct window_entry *back;
+        u32 slot;
+
+        /* The deque holds at most size entries, one of them may leave now */
+        while (q->len && (u32)(seq - q->entries[q->head].seq) >= size) {
+                q->head = (q->head + 1 == size) ? 0 : q->head + 1;
+                q->len--;
+        }
+
+        while (q->len) {
+                slot = (q->head + q->len - 1) % size;
+                back = &q->entries[slot];
+                if (is_max ? back->value > value : back->value < value)
+                        break;
+                q->len--;
+        }
+
+        slot = (q->head + q->len) % size;
+        q->entries[slot].seq = seq;
+        q->entries[slot].value = value;
+        q->len++;
+}
+
+/**
+ * Add a value to the window, dropping the oldest one once it is full. O(1)
+ * amortized, called by the producer for each sample it pushes, so from softirq
+ * context or with bottom halves disabled.
+ * @param[in] window Window of the instance
+ * @param[in] value Temperature of the sample, in milli-Celsius
+ */
+void window_add(struct sliding_window *window, s32 value)
+{
+        s32 old;
+
+        spin_lock(&window->lock);
+
+        if (window->count == window->size) {
+                old = window->values[window->head];
+                window->sum -= old;
+                window->sum_sq -= (u64)((s64)old * old);
+        } else {
+                window->count++;
+        }
+
+        window->values[window->head] = value;
+        window->head = (window->head + 1 == window->size) ? 0 : window->head + 1;
+        window->sum += value;
+        window->sum_sq += (u64)((s64)value * value);
+
+        window->seq++;
+        deque_push(&window->min_q, window->size, window->seq, value, false);
+        deque_push(&window->max_q, window->size, window->seq, value, true);
+
+        spin_unlock(&window->lock);
+}
+
+/**
+ * Get the aggregates of the window. The mean and variance are computed here
+ * from the exact sums, with a division each.
+ * @param[in] window Window of the instance
+ * @param[out] out Aggregates, all 0 but size while the window is empty
+ */
+void window_read(struct sliding_window *window, struct simtemp_window *out)
+{
+        u64 n;
+
+        *out = (struct simtemp_window){ 0 };
+
+        spin_lock_bh(&window->lock);
+        out->size = window->size;
+        out->count = window->count;
+        out->sum_mC = window->sum;
+        if (window->count) {
+                out->min_mC = window->min_q.entries[window->min_q.head].value;
+                out->max_mC = window->max_q.entries[window->max_q.head].value;
+                out->mean_mC = div_s64(window->sum, window->count);
+
+                /*
+                 * n * sum_sq - sum^2 is n^2 times the variance, and never
+                 * negative. WINDOW_SIZE_MAX keeps both terms within 64 bits.
+                 */
+                n = window->count;
+                out->variance_mC2 = div64_u64(n * window->sum_sq -
+                                              (u64)(window->sum * window->sum), n * n);
+        }
+        spin_unlock_bh(&window->lock);
+}
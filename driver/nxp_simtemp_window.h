@@ -0,0 +1,22 @@
+#ifndef NXP_SIMTEMP_WINDOW_H
+#define NXP_SIMTEMP_WINDOW_H
+
+#include <linux/types.h>
+
+#include "nxp_simtemp.h"
+
+#define WINDOW_SIZE_DEFAULT (128)
+#define WINDOW_SIZE_MIN (1)
+/* Keeps n * sum of squares, and the square of the sum, within 64 bits */
+#define WINDOW_SIZE_MAX (1 << 14)
+
+/* Aggregates over the last samples, opaque outside of the component */
+struct sliding_window;
+
+struct sliding_window *init_window(u32 size);
+void destroy_window(struct sliding_window *window);
+int window_resize(struct sliding_window *window, u32 size);
+void window_add(struct sliding_window *window, s32 value);
+void window_read(struct sliding_window *window, struct simtemp_window *out);
+
+#endif
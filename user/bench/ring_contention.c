@@ -0,0 +1,162 @@
+/*
+ * Ring buffer read contention benchmark.
+ *
+ * Spawns N reader threads that each keep re-reading the sample history of
+ * /dev/simtemp (seek to the oldest entry, read as much as the driver hands
+ * out) while the producer keeps pushing. The aggregate samples/s is a proxy
+ * for how well the ring buffer's read path scales with concurrent readers.
+ * Run it against two builds of the module to get a before/after comparison.
+ *
+ * Usage: ring_contention [-t threads] [-d seconds] [-s sampling_ms]
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../driver/nxp_simtemp.h"
+
+#define DEVICE_PATH      "/dev/simtemp"
+#define SAMPLING_MS_PATH "/sys/class/nxp_simtemp/simtemp0/sampling_ms"
+
+/* Big enough for the whole history in one request */
+#define HISTORY_SAMPLES  4096
+
+struct reader_result {
+        unsigned long long reads;
+        unsigned long long samples;
+        unsigned long long errors;
+};
+
+static atomic_bool stop;
+
+static double now_s(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int set_sampling_ms(unsigned int sampling_ms)
+{
+        FILE *f = fopen(SAMPLING_MS_PATH, "w");
+
+        if (!f)
+                return -1;
+
+        fprintf(f, "%u", sampling_ms);
+        return fclose(f);
+}
+
+static void *reader(void *arg)
+{
+        struct reader_result *result = arg;
+        struct simtemp_sample *history;
+        ssize_t len;
+        int fd;
+
+        history = calloc(HISTORY_SAMPLES, sizeof(*history));
+        fd = open(DEVICE_PATH, O_RDONLY | O_NONBLOCK);
+        if (!history || fd < 0) {
+                result->errors++;
+                goto out;
+        }
+
+        while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+                /* Fails while the ring is still empty */
+                if (lseek(fd, 0, SEEK_SET) < 0)
+                        continue;
+
+                len = read(fd, history, HISTORY_SAMPLES * sizeof(*history));
+                if (len < 0) {
+                        if (errno != EAGAIN)
+                                result->errors++;
+                        continue;
+                }
+
+                result->reads++;
+                result->samples += len / sizeof(*history);
+        }
+
+out:
+        if (fd >= 0)
+                close(fd);
+        free(history);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        unsigned int threads = 4;
+        unsigned int duration_s = 5;
+        unsigned int sampling_ms = 0;
+        struct reader_result total = { 0 };
+        struct reader_result *results;
+        pthread_t *tids;
+        double start, elapsed;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "t:d:s:")) != -1) {
+                switch (opt) {
+                case 't':
+                        threads = strtoul(optarg, NULL, 0);
+                        break;
+                case 'd':
+                        duration_s = strtoul(optarg, NULL, 0);
+                        break;
+                case 's':
+                        sampling_ms = strtoul(optarg, NULL, 0);
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-t threads] [-d seconds] [-s sampling_ms]\n",
+                                argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (threads == 0) {
+                fprintf(stderr, "Need at least one reader thread\n");
+                return EXIT_FAILURE;
+        }
+
+        if (sampling_ms && set_sampling_ms(sampling_ms)) {
+                fprintf(stderr, "Failed to set sampling_ms: %s\n", strerror(errno));
+                return EXIT_FAILURE;
+        }
+
+        results = calloc(threads, sizeof(*results));
+        tids = calloc(threads, sizeof(*tids));
+        if (!results || !tids)
+                return EXIT_FAILURE;
+
+        start = now_s();
+        for (unsigned int i = 0; i < threads; i++)
+                pthread_create(&tids[i], NULL, reader, &results[i]);
+
+        sleep(duration_s);
+        atomic_store(&stop, true);
+
+        for (unsigned int i = 0; i < threads; i++) {
+                pthread_join(tids[i], NULL);
+                total.reads += results[i].reads;
+                total.samples += results[i].samples;
+                total.errors += results[i].errors;
+        }
+        elapsed = now_s() - start;
+
+        printf("threads=%u duration_s=%.3f reads_per_s=%.0f samples_per_s=%.0f "
+               "samples_per_s_per_thread=%.0f errors=%llu\n",
+               threads, elapsed, total.reads / elapsed, total.samples / elapsed,
+               total.samples / elapsed / threads, total.errors);
+
+        free(tids);
+        free(results);
+        return total.errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
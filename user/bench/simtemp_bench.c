@@ -0,0 +1,556 @@
+/*
+ * Consumer throughput and wakeup latency benchmark.
+ *
+ * Runs a grid of (access mode x sampling_ms x consumer count) cells against
+ * one simtemp instance. Each cell spawns the consumer threads, lets them run
+ * for the requested duration, and prints one result row:
+ *
+ *   - samples_per_s: samples delivered to all consumers, per second
+ *   - syscalls_per_sample: syscalls issued per delivered sample
+ *   - missed: samples the producer pushed that a consumer never saw, summed
+ *     over consumers (needs the stats/samples_produced attribute)
+ *   - lat_p50/p99/p999_us: time from the sample timestamp until the consumer
+ *     had it, for every newly seen sample
+ *
+ * Access modes:
+ *   block    blocking read() of the latest sample
+ *   nonblock O_NONBLOCK read() in a loop, spinning on EAGAIN
+ *   poll     poll() then read()
+ *   epoll    epoll_wait() then read()
+ *   history  seek to the oldest entry and read the whole history
+ *   mmap     poll() for a new sample, then copy it out of the mapped ring
+ *
+ * Output is CSV by default, or one JSON object per cell with -j.
+ *
+ * Usage: simtemp_bench [-i instance] [-d seconds] [-m modes] [-s sampling_ms list]
+ *                      [-c consumers list] [-j]
+ *   lists are comma separated, e.g. -m block,poll -s 1,10,100 -c 1,4,16
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../driver/nxp_simtemp.h"
+
+#define MAX_GRID         16
+#define HISTORY_SAMPLES  4096
+/* poll()/epoll_wait() timeout, so consumers notice the end of a cell */
+#define WAIT_TIMEOUT_MS  100
+
+enum bench_mode {
+        mode_block,
+        mode_nonblock,
+        mode_poll,
+        mode_epoll,
+        mode_history,
+        mode_mmap,
+        mode_count
+};
+
+/* Must be in the same order as enum bench_mode */
+static const char *mode_names[] = {
+        "block",
+        "nonblock",
+        "poll",
+        "epoll",
+        "history",
+        "mmap"
+};
+
+struct latencies {
+        uint64_t *ns;
+        size_t len, cap;
+};
+
+struct consumer_result {
+        unsigned long long samples;  /* Delivered, duplicates included */
+        unsigned long long unique;   /* Not seen before by this consumer */
+        unsigned long long syscalls;
+        unsigned long long errors;
+        struct latencies lat;
+};
+
+struct consumer {
+        pthread_t tid;
+        enum bench_mode mode;
+        struct consumer_result result;
+        uint64_t last_ts; /* Timestamp of the newest sample seen */
+};
+
+static char device_path[64];
+static char sysfs_path[64];
+static atomic_bool stop;
+
+static uint64_t boottime_ns(void)
+{
+        struct timespec ts;
+
+        /* Same clock as the sample timestamps */
+        clock_gettime(CLOCK_BOOTTIME, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double now_s(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int write_attr(const char *name, unsigned int value)
+{
+        char path[128];
+        FILE *f;
+
+        snprintf(path, sizeof(path), "%s/%s", sysfs_path, name);
+        f = fopen(path, "w");
+        if (!f)
+                return -1;
+
+        fprintf(f, "%u", value);
+        return fclose(f);
+}
+
+static long long read_attr(const char *name)
+{
+        char path[128];
+        long long value;
+        FILE *f;
+
+        snprintf(path, sizeof(path), "%s/%s", sysfs_path, name);
+        f = fopen(path, "r");
+        if (!f)
+                return -1;
+
+        if (fscanf(f, "%lld", &value) != 1)
+                value = -1;
+        fclose(f);
+        return value;
+}
+
+static void lat_push(struct latencies *lat, uint64_t ns)
+{
+        if (lat->len == lat->cap) {
+                size_t cap = lat->cap ? lat->cap * 2 : 1024;
+                uint64_t *ns_buf = realloc(lat->ns, cap * sizeof(*ns_buf));
+
+                /* Out of memory only costs precision */
+                if (!ns_buf)
+                        return;
+                lat->ns = ns_buf;
+                lat->cap = cap;
+        }
+        lat->ns[lat->len++] = ns;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+        uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+        return (x > y) - (x < y);
+}
+
+/**
+ * Account a batch of samples, the newest last.
+ */
+static void account(struct consumer *c, const struct simtemp_sample *samples, size_t count)
+{
+        uint64_t now = boottime_ns();
+
+        c->result.samples += count;
+        for (size_t i = 0; i < count; i++) {
+                if (samples[i].timestamp <= c->last_ts)
+                        continue;
+
+                c->last_ts = samples[i].timestamp;
+                c->result.unique++;
+                /* Only the newest sample was waited for */
+                if (i == count - 1)
+                        lat_push(&c->result.lat, now - samples[i].timestamp);
+        }
+}
+
+static void read_latest(struct consumer *c, int fd)
+{
+        struct simtemp_sample sample;
+        ssize_t len;
+
+        len = read(fd, &sample, sizeof(sample));
+        c->result.syscalls++;
+        if (len == sizeof(sample))
+                account(c, &sample, 1);
+        else if (len < 0 && errno != EAGAIN && errno != EINTR)
+                c->result.errors++;
+}
+
+static void run_block(struct consumer *c, int fd)
+{
+        while (!atomic_load_explicit(&stop, memory_order_relaxed))
+                read_latest(c, fd);
+}
+
+static void run_poll(struct consumer *c, int fd)
+{
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+        while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+                c->result.syscalls++;
+                if (poll(&pfd, 1, WAIT_TIMEOUT_MS) > 0)
+                        read_latest(c, fd);
+        }
+}
+
+static void run_epoll(struct consumer *c, int fd)
+{
+        struct epoll_event ev = { .events = EPOLLIN };
+        int epfd = epoll_create1(0);
+
+        if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+                c->result.errors++;
+                goto out;
+        }
+
+        while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+                c->result.syscalls++;
+                if (epoll_wait(epfd, &ev, 1, WAIT_TIMEOUT_MS) > 0)
+                        read_latest(c, fd);
+        }
+
+out:
+        if (epfd >= 0)
+                close(epfd);
+}
+
+static void run_history(struct consumer *c, int fd)
+{
+        struct simtemp_sample *history = calloc(HISTORY_SAMPLES, sizeof(*history));
+        ssize_t len;
+
+        if (!history) {
+                c->result.errors++;
+                return;
+        }
+
+        while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+                c->result.syscalls += 2;
+                /* Fails while the ring is still empty */
+                if (lseek(fd, 0, SEEK_SET) < 0)
+                        continue;
+
+                len = read(fd, history, HISTORY_SAMPLES * sizeof(*history));
+                if (len > 0)
+                        account(c, history, len / sizeof(*history));
+                else if (len < 0 && errno != EAGAIN)
+                        c->result.errors++;
+        }
+
+        free(history);
+}
+
+/**
+ * Copy the latest sample out of the mapped ring, following the seqcount
+ * protocol of struct simtemp_ring_header.
+ * @return int - 0 on success, -1 if the ring is empty
+ */
+static int mmap_latest(const struct simtemp_ring_header *hdr, struct simtemp_sample *out)
+{
+        const struct simtemp_sample *slots =
+                (const void *)((const char *)hdr + hdr->data_offset);
+        uint32_t seq, len, head;
+
+        do {
+                while ((seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE)) & 1)
+                        ;
+                len = __atomic_load_n(&hdr->len, __ATOMIC_RELAXED);
+                head = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+                if (len)
+                        memcpy(out, &slots[(head - 1) & (hdr->capacity - 1)], sizeof(*out));
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while (__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) != seq);
+
+        return len ? 0 : -1;
+}
+
+static void run_mmap(struct consumer *c, int fd)
+{
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        struct simtemp_ring_header *hdr;
+        struct simtemp_sample sample;
+        long page = sysconf(_SC_PAGESIZE);
+        size_t size;
+
+        /* Map the header alone first, to learn the size of the ring */
+        hdr = mmap(NULL, page, PROT_READ, MAP_SHARED, fd, 0);
+        if (hdr == MAP_FAILED) {
+                c->result.errors++;
+                return;
+        }
+        size = hdr->data_offset + (size_t)hdr->capacity * sizeof(struct simtemp_sample);
+        size = (size + page - 1) & ~(size_t)(page - 1);
+        munmap(hdr, page);
+
+        hdr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (hdr == MAP_FAILED) {
+                c->result.errors++;
+                return;
+        }
+
+        /* For a mapped handle, POLLIN also consumes the latest entry */
+        while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+                c->result.syscalls++;
+                if (poll(&pfd, 1, WAIT_TIMEOUT_MS) > 0 && !mmap_latest(hdr, &sample))
+                        account(c, &sample, 1);
+        }
+
+        munmap(hdr, size);
+}
+
+static void *consumer(void *arg)
+{
+        struct consumer *c = arg;
+        int flags = O_RDONLY;
+        int fd;
+
+        if (c->mode == mode_nonblock || c->mode == mode_history)
+                flags |= O_NONBLOCK;
+
+        fd = open(device_path, flags);
+        if (fd < 0) {
+                c->result.errors++;
+                return NULL;
+        }
+
+        switch (c->mode) {
+        case mode_block:
+        case mode_nonblock:
+                run_block(c, fd);
+                break;
+        case mode_poll:
+                run_poll(c, fd);
+                break;
+        case mode_epoll:
+                run_epoll(c, fd);
+                break;
+        case mode_history:
+                run_history(c, fd);
+                break;
+        case mode_mmap:
+                run_mmap(c, fd);
+                break;
+        default:
+                break;
+        }
+
+        close(fd);
+        return NULL;
+}
+
+static double percentile_us(const struct latencies *lat, unsigned int per_mille)
+{
+        size_t rank;
+
+        if (!lat->len)
+                return -1;
+
+        rank = ((size_t)lat->len * per_mille + 999) / 1000;
+        return lat->ns[rank ? rank - 1 : 0] / 1000.0;
+}
+
+static void print_header(bool json)
+{
+        if (!json)
+                printf("mode,sampling_ms,consumers,duration_s,samples,samples_per_s,"
+                       "syscalls_per_sample,missed,lat_p50_us,lat_p99_us,lat_p999_us,errors\n");
+}
+
+static void print_row(bool json, enum bench_mode mode, unsigned int sampling_ms,
+                      unsigned int consumers, double elapsed,
+                      const struct consumer_result *total, long long missed)
+{
+        double per_sample = total->samples ? (double)total->syscalls / total->samples : 0;
+
+        if (json)
+                printf("{\"mode\":\"%s\",\"sampling_ms\":%u,\"consumers\":%u,"
+                       "\"duration_s\":%.3f,\"samples\":%llu,\"samples_per_s\":%.1f,"
+                       "\"syscalls_per_sample\":%.3f,\"missed\":%lld,"
+                       "\"lat_p50_us\":%.1f,\"lat_p99_us\":%.1f,\"lat_p999_us\":%.1f,"
+                       "\"errors\":%llu}\n",
+                       mode_names[mode], sampling_ms, consumers, elapsed, total->samples,
+                       total->samples / elapsed, per_sample, missed,
+                       percentile_us(&total->lat, 500), percentile_us(&total->lat, 990),
+                       percentile_us(&total->lat, 999), total->errors);
+        else
+                printf("%s,%u,%u,%.3f,%llu,%.1f,%.3f,%lld,%.1f,%.1f,%.1f,%llu\n",
+                       mode_names[mode], sampling_ms, consumers, elapsed, total->samples,
+                       total->samples / elapsed, per_sample, missed,
+                       percentile_us(&total->lat, 500), percentile_us(&total->lat, 990),
+                       percentile_us(&total->lat, 999), total->errors);
+        fflush(stdout);
+}
+
+/**
+ * Run a single cell of the grid and print its row.
+ * @return int - Number of consumer errors
+ */
+static int run_cell(enum bench_mode mode, unsigned int sampling_ms, unsigned int consumers,
+                    unsigned int duration_s, bool json)
+{
+        struct consumer_result total = { 0 };
+        struct consumer *cs;
+        long long produced_start, produced_end, missed = -1;
+        double start, elapsed;
+
+        if (sampling_ms && write_attr("sampling_ms", sampling_ms))
+                fprintf(stderr, "Failed to set sampling_ms: %s\n", strerror(errno));
+
+        cs = calloc(consumers, sizeof(*cs));
+        if (!cs)
+                return 1;
+
+        atomic_store(&stop, false);
+        produced_start = read_attr("stats/samples_produced");
+        start = now_s();
+        for (unsigned int i = 0; i < consumers; i++) {
+                cs[i].mode = mode;
+                /* Only samples produced from now on count */
+                cs[i].last_ts = boottime_ns();
+                pthread_create(&cs[i].tid, NULL, consumer, &cs[i]);
+        }
+
+        sleep(duration_s);
+        atomic_store(&stop, true);
+
+        for (unsigned int i = 0; i < consumers; i++) {
+                struct latencies *lat = &cs[i].result.lat;
+
+                pthread_join(cs[i].tid, NULL);
+                total.samples += cs[i].result.samples;
+                total.unique += cs[i].result.unique;
+                total.syscalls += cs[i].result.syscalls;
+                total.errors += cs[i].result.errors;
+
+                for (size_t j = 0; j < lat->len; j++)
+                        lat_push(&total.lat, lat->ns[j]);
+                free(lat->ns);
+        }
+        elapsed = now_s() - start;
+        produced_end = read_attr("stats/samples_produced");
+
+        if (produced_start >= 0 && produced_end >= produced_start) {
+                long long expected = (produced_end - produced_start) * (long long)consumers;
+
+                missed = expected > (long long)total.unique ? expected - total.unique : 0;
+        }
+
+        qsort(total.lat.ns, total.lat.len, sizeof(uint64_t), cmp_u64);
+        print_row(json, mode, sampling_ms, consumers, elapsed, &total, missed);
+
+        free(total.lat.ns);
+        free(cs);
+        return total.errors != 0;
+}
+
+/**
+ * Parse a comma separated list of numbers.
+ * @return size_t - Number of entries parsed
+ */
+static size_t parse_list(const char *arg, unsigned int *out)
+{
+        char *copy = strdup(arg), *save = NULL, *tok;
+        size_t n = 0;
+
+        for (tok = strtok_r(copy, ",", &save); tok && n < MAX_GRID;
+             tok = strtok_r(NULL, ",", &save))
+                out[n++] = strtoul(tok, NULL, 0);
+
+        free(copy);
+        return n;
+}
+
+static size_t parse_modes(const char *arg, unsigned int *out)
+{
+        char *copy = strdup(arg), *save = NULL, *tok;
+        size_t n = 0;
+
+        for (tok = strtok_r(copy, ",", &save); tok && n < MAX_GRID;
+             tok = strtok_r(NULL, ",", &save)) {
+                for (unsigned int m = 0; m < mode_count; m++) {
+                        if (!strcmp(tok, mode_names[m]))
+                                out[n++] = m;
+                }
+        }
+
+        free(copy);
+        return n;
+}
+
+int main(int argc, char **argv)
+{
+        unsigned int modes[MAX_GRID] = { mode_block, mode_poll };
+        unsigned int sampling[MAX_GRID] = { 10 };
+        unsigned int consumers[MAX_GRID] = { 1, 4 };
+        size_t n_modes = 2, n_sampling = 1, n_consumers = 2;
+        unsigned int instance = 0;
+        unsigned int duration_s = 5;
+        bool json = false;
+        int failures = 0;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "i:d:m:s:c:j")) != -1) {
+                switch (opt) {
+                case 'i':
+                        instance = strtoul(optarg, NULL, 0);
+                        break;
+                case 'd':
+                        duration_s = strtoul(optarg, NULL, 0);
+                        break;
+                case 'm':
+                        n_modes = parse_modes(optarg, modes);
+                        break;
+                case 's':
+                        n_sampling = parse_list(optarg, sampling);
+                        break;
+                case 'c':
+                        n_consumers = parse_list(optarg, consumers);
+                        break;
+                case 'j':
+                        json = true;
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-i instance] [-d seconds] [-m modes] "
+                                "[-s sampling_ms list] [-c consumers list] [-j]\n", argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (!n_modes || !n_sampling || !n_consumers) {
+                fprintf(stderr, "Empty mode, sampling_ms or consumers list\n");
+                return EXIT_FAILURE;
+        }
+
+        snprintf(device_path, sizeof(device_path), "/dev/simtemp%u", instance);
+        snprintf(sysfs_path, sizeof(sysfs_path), "/sys/class/nxp_simtemp/simtemp%u", instance);
+
+        print_header(json);
+        for (size_t m = 0; m < n_modes; m++)
+                for (size_t s = 0; s < n_sampling; s++)
+                        for (size_t c = 0; c < n_consumers; c++)
+                                if (consumers[c])
+                                        failures += run_cell(modes[m], sampling[s],
+                                                             consumers[c], duration_s, json);
+
+        return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
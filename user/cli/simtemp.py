@@ -6,8 +6,9 @@ import errno
 import select
 
 # --- Constants ---
-DEVICE_PATH = '/dev/simtemp'
-SYSFS_PATH = '/sys/class/nxp_simtemp/simtemp'
+# Paths of the instance in use, see set_instance()
+DEVICE_PATH = '/dev/simtemp0'
+SYSFS_PATH = '/sys/class/nxp_simtemp/simtemp0'
 # u64 (timestamp), s32 (temp_mC), u32 (flags)
 SAMPLE_FORMAT = 'QiI'
 SAMPLE_SIZE = struct.calcsize(SAMPLE_FORMAT)  # Should be 16 bytes
@@ -43,6 +44,12 @@ def get_sysfs_param(param_name):
     except Exception:
         return None
 
+def set_instance(instance):
+    """Points the script at the given simtemp instance."""
+    global DEVICE_PATH, SYSFS_PATH
+    DEVICE_PATH = f'/dev/simtemp{instance}'
+    SYSFS_PATH = f'/sys/class/nxp_simtemp/simtemp{instance}'
+
 def configure_device(config_dict):
     """Applies configuration parameters."""
     if not config_dict:
@@ -331,6 +338,13 @@ Examples:
   --config threshold_mC=50000 sampling_ms=500
 """
     )
+    parser.add_argument(
+        '-i', '--instance',
+        type=int,
+        default=0,
+        metavar='N',
+        help='Index of the simtemp instance to use (default: 0).'
+    )
     parser.add_argument(
         '-t', '--timeout',
         type=int,
@@ -343,6 +357,7 @@ Examples:
     subparsers.add_parser('test', help='Run a set of functional tests.')
 
     args = parser.parse_args()
+    set_instance(args.instance)
 
     # Process config arguments into a dictionary
     config_dict = {}
@@ -0,0 +1,95 @@
+/*
+ * libFuzzer target for the file offset arithmetic of the driver.
+ *
+ * Links the unmodified nxp_simtemp_offset.c and feeds simtemp_seek() and
+ * simtemp_history_count() arbitrary offsets, whence values, entry indices,
+ * read lengths and ring sizes, checking that every seek lands on a whole
+ * entry inside the ring and that a history read never runs past it. Built
+ * with the address and undefined behavior sanitizers, so overflows in the
+ * arithmetic abort too.
+ *
+ * Usage: make fuzz && ./fuzz_offset [corpus dir] [libFuzzer options]
+ */
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/limits.h>
+#include <linux/errno.h>
+
+#include "nxp_simtemp.h"
+#include "nxp_simtemp_buffer.h"
+#include "nxp_simtemp_offset.h"
+
+#define SAMPLE_SIZE ((s64)sizeof(struct simtemp_sample))
+/* Written by simtemp_seek() only on success */
+#define IDX_UNTOUCHED 0xdeadbeefU
+
+struct fuzz_input {
+        s64 loff;
+        s32 whence;
+        u32 entry_idx;
+        u64 count;
+        u32 size;
+};
+
+static void check_seek(const struct fuzz_input *in, size_t size)
+{
+        u32 new_idx = IDX_UNTOUCHED, again_idx = IDX_UNTOUCHED;
+        loff_t ret, again;
+        s64 pos;
+
+        ret = simtemp_seek(in->loff, in->whence, in->entry_idx, size, &new_idx);
+        if (ret < 0) {
+                if ((ret != -EINVAL) || (new_idx != IDX_UNTOUCHED))
+                        __builtin_trap();
+                return;
+        }
+
+        if ((in->whence != SEEK_SET) && (in->whence != SEEK_CUR) &&
+            (in->whence != SEEK_END))
+                __builtin_trap();
+
+        /* A whole entry inside the ring, the last one latched as the latest */
+        if (ret % SAMPLE_SIZE)
+                __builtin_trap();
+        pos = ret / SAMPLE_SIZE;
+        if (pos >= (s64)size)
+                __builtin_trap();
+        if (new_idx != ((pos == (s64)size - 1) ? UINT_MAX : (u32)pos))
+                __builtin_trap();
+
+        /* Seeking back to where it landed lands there again */
+        again = simtemp_seek(ret, SEEK_SET, new_idx, size, &again_idx);
+        if ((again != ret) || (again_idx != new_idx))
+                __builtin_trap();
+}
+
+static void check_history_count(const struct fuzz_input *in, size_t size)
+{
+        size_t count;
+
+        count = simtemp_history_count(in->count, size, in->entry_idx);
+        if (count > in->count)
+                __builtin_trap();
+        if ((in->entry_idx >= size) ? count : (in->entry_idx + count > size))
+                __builtin_trap();
+        /* Everything from the position up to the oldest entry is readable */
+        if ((in->entry_idx < size) && (count < in->count) &&
+            (in->entry_idx + count != size))
+                __builtin_trap();
+}
+
+int LLVMFuzzerTestOneInput(const u8 *data, size_t len)
+{
+        struct fuzz_input in = { 0 };
+        size_t size;
+
+        memcpy(&in, data, min(len, sizeof(in)));
+
+        /* The ring never holds more than BUFFER_CAPACITY_MAX entries */
+        size = in.size % (BUFFER_CAPACITY_MAX + 1);
+
+        check_seek(&in, size);
+        check_history_count(&in, size);
+
+        return 0;
+}
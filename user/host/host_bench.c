@@ -0,0 +1,348 @@
+/*
+ * Host-side micro benchmark of the driver's hot paths.
+ *
+ * Links the unmodified ring buffer, generator and offset sources (see the
+ * Makefile) and times each call in a tight loop, reporting ns and cycles per
+ * call. Useful to compare changes to those components without a target
+ * board, and to run them under perf, valgrind or the sanitizers.
+ *
+ * The tick cases mirror one producer tick of the core: generate a sample,
+ * push it, and have K woken consumers each fetch the latest entry.
+ *
+ * Usage: host_bench [-n iterations] [-c capacity] [-k consumers,...]
+ */
+#include <linux/types.h>
+#include <linux/ktime.h>
+
+#include "nxp_simtemp_buffer.h"
+#include "nxp_simtemp_generators.h"
+#include "nxp_simtemp_offset.h"
+#include "nxp_simtemp_rollup.h"
+#include "nxp_simtemp_window.h"
+#include "nxp_simtemp_alarm.h"
+#include "nxp_simtemp_replay.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define read_cycles() __rdtsc()
+#else
+/* No portable cycle counter, only ns/op is meaningful there */
+#define read_cycles() 0ULL
+#endif
+
+/* Keeps the compiler from dropping the measured calls */
+static volatile s64 sink;
+
+struct bench_ctx {
+        struct lifo_ring_buffer *rb;
+        struct simtemp_rollup *rollup;
+        struct sliding_window *window;
+        struct simtemp_alarms *alarms;
+        struct simtemp_params params;
+        struct simtemp_gen_state gen;
+        struct simtemp_sample history[64];
+        struct simtemp_sample batch[16]; /* Backfill sized, see the core */
+        size_t size;
+        u64 oldest_ts; /* Timestamp of the oldest entry after the push run */
+        unsigned int consumers;
+};
+
+static void bench_push(struct bench_ctx *ctx, u64 i)
+{
+        struct simtemp_sample sample = { .timestamp = i, .temp_mC = (s32)i };
+
+        ring_buffer_push(ctx->rb, &sample);
+}
+
+static void bench_peek(struct bench_ctx *ctx, u64 i)
+{
+        struct simtemp_sample sample;
+
+        ring_buffer_peek(ctx->rb, i & (ctx->size - 1), &sample);
+        sink += sample.temp_mC;
+}
+
+static void bench_peek_range(struct bench_ctx *ctx, u64 i)
+{
+        u64 published;
+
+        sink += ring_buffer_peek_range(ctx->rb, 0, ARRAY_SIZE(ctx->history),
+                                       ctx->history, &published);
+}
+
+static void bench_peek_latest(struct bench_ctx *ctx, u64 i)
+{
+        struct simtemp_sample sample;
+        u64 published;
+
+        ring_buffer_peek_latest(ctx->rb, &sample, &published);
+        sink += sample.temp_mC;
+}
+
+static void bench_rollup_add(struct bench_ctx *ctx, u64 i)
+{
+        /* 1 kHz sampling, so the 1 s buckets roll over every 1000 samples */
+        struct simtemp_sample sample = { .timestamp = i * 1000000, .temp_mC = (s32)(i & 0xffff) };
+
+        rollup_add(ctx->rollup, &sample);
+}
+
+static void bench_window_add(struct bench_ctx *ctx, u64 i)
+{
+        /* Hashed, so the deques see both rising and falling runs */
+        window_add(ctx->window, (s32)((i * 2654435761u) & 0x1ffff) - 50000);
+}
+
+static void bench_window_read(struct bench_ctx *ctx, u64 i)
+{
+        struct simtemp_window window;
+
+        window_read(ctx->window, &window);
+        sink += window.variance_mC2;
+}
+
+static void bench_alarms_check(struct bench_ctx *ctx, u64 i)
+{
+        /* Slow triangle over the whole range, crossing every band twice per
+         * period, like a ramp does */
+        s32 phase = (s32)(i % 340000);
+        struct simtemp_sample sample = {
+                .timestamp = i,
+                .temp_mC = MIN_TEMP + (phase < 170000 ? phase : 340000 - phase),
+        };
+
+        sink += alarms_check(ctx->alarms, &sample, i);
+}
+
+static void bench_find_timestamp(struct bench_ctx *ctx, u64 i)
+{
+        size_t len;
+        u64 published;
+
+        sink += ring_buffer_find_timestamp(ctx->rb, ctx->oldest_ts + i % ctx->size,
+                                           &len, &published);
+}
+
+static void bench_generator(struct bench_ctx *ctx, u64 i)
+{
+        struct simtemp_sample sample;
+
+        get_temp_sample(&sample, (ktime_t)(i * 1000000), &ctx->params, &ctx->gen);
+        sink += sample.temp_mC;
+}
+
+/* Per sample, the generator fills batch every ARRAY_SIZE(batch) calls */
+static void bench_generator_batch(struct bench_ctx *ctx, u64 i)
+{
+        u64 slot = i % ARRAY_SIZE(ctx->batch);
+
+        if (!slot)
+                get_temp_samples(ctx->batch, ARRAY_SIZE(ctx->batch), (ktime_t)(i * 1000000),
+                                 1000000, &ctx->params, &ctx->gen);
+        sink += ctx->batch[slot].temp_mC;
+}
+
+/* A trace for the replay mode, 1 ms apart, a sawtooth over the range */
+static int load_replay_trace(struct simtemp_replay *replay, u32 records)
+{
+        struct simtemp_trace_header header = {
+                .magic = SIMTEMP_TRACE_MAGIC,
+                .version = SIMTEMP_TRACE_VERSION,
+                .format = SIMTEMP_TRACE_SAMPLES,
+        };
+        struct simtemp_sample sample = { 0 };
+        u64 offset = sizeof(header);
+
+        if (replay_load(replay, &header, sizeof(header), 0) < 0)
+                return -1;
+
+        for (u32 i = 0; i < records; i++) {
+                sample.timestamp = (u64)i * 1000000;
+                sample.temp_mC = MIN_TEMP + (s32)(i % (MAX_TEMP - MIN_TEMP));
+                if (replay_load(replay, &sample, sizeof(sample), offset) < 0)
+                        return -1;
+                offset += sizeof(sample);
+        }
+
+        return replay_commit(replay);
+}
+
+static void bench_seek(struct bench_ctx *ctx, u64 i)
+{
+        u32 idx;
+
+        sink += simtemp_seek((loff_t)(i & (ctx->size - 1)) * sizeof(struct simtemp_sample),
+                             SEEK_SET, 0, ctx->size, &idx);
+}
+
+static void bench_tick(struct bench_ctx *ctx, u64 i)
+{
+        struct simtemp_sample sample;
+        u64 published;
+
+        get_temp_sample(&sample, (ktime_t)(i * 1000000), &ctx->params, &ctx->gen);
+        ring_buffer_push(ctx->rb, &sample);
+
+        for (unsigned int c = 0; c < ctx->consumers; c++) {
+                ring_buffer_peek_latest(ctx->rb, &sample, &published);
+                sink += sample.temp_mC;
+        }
+}
+
+static void run(const char *name, void (*fn)(struct bench_ctx *, u64),
+                struct bench_ctx *ctx, u64 iterations)
+{
+        u64 start, elapsed;
+        u64 start_cycles, cycles;
+
+        start = ktime_get_ns();
+        start_cycles = read_cycles();
+        for (u64 i = 0; i < iterations; i++)
+                fn(ctx, i);
+        cycles = read_cycles() - start_cycles;
+        elapsed = ktime_get_ns() - start;
+
+        printf("%-28s %8.2f ns/op %10.1f cycles/op\n", name,
+               (double)elapsed / iterations, (double)cycles / iterations);
+}
+
+int main(int argc, char **argv)
+{
+        struct bench_ctx ctx = { 0 };
+        u64 iterations = 10000000;
+        size_t capacity = BUFFER_CAPACITY;
+        char default_consumers[] = "1,4,16"; /* strtok() writes to it */
+        char *consumer_list = default_consumers;
+        char name[32];
+        char *tok;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "n:c:k:")) != -1) {
+                switch (opt) {
+                case 'n':
+                        iterations = strtoull(optarg, NULL, 0);
+                        break;
+                case 'c':
+                        capacity = strtoul(optarg, NULL, 0);
+                        break;
+                case 'k':
+                        consumer_list = optarg;
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-n iterations] [-c capacity] [-k consumers,...]\n",
+                                argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (!iterations) {
+                fprintf(stderr, "Need at least one iteration\n");
+                return EXIT_FAILURE;
+        }
+
+        ctx.rb = init_ring_buffer();
+        if (!ctx.rb || ring_buffer_resize(ctx.rb, capacity)) {
+                fprintf(stderr, "Failed to set up a ring of %zu samples\n", capacity);
+                return EXIT_FAILURE;
+        }
+
+        run("ring_buffer_push", bench_push, &ctx, iterations);
+        ctx.size = get_ring_buffer_size(ctx.rb);
+        ctx.oldest_ts = iterations - ctx.size;
+        run("ring_buffer_peek", bench_peek, &ctx, iterations);
+        run("ring_buffer_peek_range", bench_peek_range, &ctx, iterations);
+        run("ring_buffer_peek_latest", bench_peek_latest, &ctx, iterations);
+        run("ring_buffer_find_timestamp", bench_find_timestamp, &ctx, iterations);
+        run("simtemp_seek", bench_seek, &ctx, iterations);
+
+        ctx.rollup = init_rollup();
+        if (!ctx.rollup) {
+                fprintf(stderr, "Failed to set up the rollup\n");
+                return EXIT_FAILURE;
+        }
+        run("rollup_add", bench_rollup_add, &ctx, iterations);
+        destroy_rollup(ctx.rollup);
+
+        ctx.window = init_window(WINDOW_SIZE_DEFAULT);
+        if (!ctx.window) {
+                fprintf(stderr, "Failed to set up the window\n");
+                return EXIT_FAILURE;
+        }
+        run("window_add", bench_window_add, &ctx, iterations);
+        run("window_read", bench_window_read, &ctx, iterations);
+        destroy_window(ctx.window);
+
+        ctx.alarms = init_alarms();
+        if (!ctx.alarms) {
+                fprintf(stderr, "Failed to set up the alarms\n");
+                return EXIT_FAILURE;
+        }
+        for (unsigned int a = 0; a < SIMTEMP_ALARMS_MAX; a++) {
+                struct simtemp_alarm_config config = {
+                        .enabled = true,
+                        .falling = a & 1,
+                        .severity = a % 3,
+                        .threshold_mC = MIN_TEMP + (s32)(a + 1) * 18000,
+                        .hysteresis_mC = 2000,
+                };
+
+                alarms_set_config(ctx.alarms, a, &config);
+        }
+        run("alarms_check", bench_alarms_check, &ctx, iterations);
+        destroy_alarms(ctx.alarms);
+
+        /* Same defaults as init_params(), which lives with the sysfs code */
+        ctx.params.ramp_min = 0;
+        ctx.params.ramp_max = 100000;
+        ctx.params.ramp_period_ms = 1000;
+        ctx.params.sampling_us = 1000;
+        ctx.params.noise_octaves = 1;
+        ctx.params.noise_amplitude_mC = MAX_TEMP - MIN_TEMP;
+        ctx.params.noise_speed = NOISE_SPEED_DEFAULT;
+        init_gen_params(&ctx.params);
+        ctx.gen.replay = init_replay();
+        if (!ctx.gen.replay || load_replay_trace(ctx.gen.replay, 1 << 20)) {
+                fprintf(stderr, "Failed to load the replay trace\n");
+                return 1;
+        }
+        for (unsigned int mode = 0; mode < simtemp_mode_count; mode++) {
+                ctx.params.mode = mode;
+                init_gen_state(&ctx.gen, &ctx.params);
+                snprintf(name, sizeof(name), "generator_%s", simtemp_generators[mode]->name);
+                run(name, bench_generator, &ctx, iterations);
+                if (!simtemp_generators[mode]->next_batch)
+                        continue;
+                snprintf(name, sizeof(name), "generator_%s_batch", simtemp_generators[mode]->name);
+                run(name, bench_generator_batch, &ctx, iterations);
+        }
+
+        /* At the recorded pace, the cursor walks the timestamps */
+        ctx.params.mode = simtemp_mode_replay;
+        ctx.params.replay_speed_pct = 100;
+        run("generator_replay_100pct", bench_generator, &ctx, iterations);
+        ctx.params.replay_speed_pct = 0;
+        destroy_replay(ctx.gen.replay);
+        ctx.gen.replay = NULL;
+
+        ctx.params.mode = simtemp_mode_normal;
+        ctx.params.noise_octaves = NOISE_OCTAVES_MAX;
+        run("generator_normal_8_octaves", bench_generator, &ctx, iterations);
+        ctx.params.noise_octaves = 1;
+
+        /* The shim's get_random_u32() is a xorshift, not the kernel's
+         * CSPRNG, so this only shows the overhead around it */
+        ctx.params.mode = simtemp_mode_noisy;
+        ctx.params.rng = simtemp_rng_csprng;
+        run("generator_noisy_csprng", bench_generator, &ctx, iterations);
+        ctx.params.rng = simtemp_rng_xoshiro;
+
+        ctx.params.mode = simtemp_mode_normal;
+        for (tok = strtok(consumer_list, ","); tok; tok = strtok(NULL, ",")) {
+                ctx.consumers = strtoul(tok, NULL, 0);
+                snprintf(name, sizeof(name), "tick_%u_consumers", ctx.consumers);
+                run(name, bench_tick, &ctx, iterations);
+        }
+
+        destroy_ring_buffer(ctx.rb);
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+#include <math.h>
+
+#include "kshim.h"
+
+pthread_rwlock_t kshim_rcu_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* xorshift32, seeded once per thread; the generators only need it cheap */
+u32 get_random_u32(void)
+{
+        static __thread u32 state;
+
+        if (!state)
+                state = (u32)ktime_get_ns() | 1;
+
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+}
+
+s32 fixp_sin32(int degrees)
+{
+        static s32 table[360];
+        static bool filled;
+        int i;
+
+        if (!filled) {
+                for (i = 0; i < 360; i++)
+                        table[i] = (s32)lround(sin(i * M_PI / 180) * 0x7fffffff);
+                filled = true;
+        }
+
+        degrees %= 360;
+        return table[degrees < 0 ? degrees + 360 : degrees];
+}
@@ -0,0 +1,294 @@
+/*
+ * Minimal userspace stand-ins for the kernel APIs used by the ring buffer,
+ * the generators and the offset arithmetic, so those files build unchanged
+ * on the host. Every linux/ header in this directory includes this file.
+ *
+ * linux/errno.h and linux/limits.h are left to the host uapi headers, which
+ * the libc headers include themselves.
+ *
+ * Locks map to pthreads, RCU to a process wide rwlock (readers take it
+ * shared, synchronize_rcu() waits for them by taking it exclusive), and
+ * memory barriers to the matching C11 fences. Nothing here is meant to be
+ * fast except what the driver's own hot paths use.
+ */
+#ifndef SIMTEMP_KSHIM_H
+#define SIMTEMP_KSHIM_H
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************** TYPES ********************/
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+
+typedef u8 __u8;
+typedef u16 __u16;
+typedef u32 __u32;
+typedef u64 __u64;
+typedef s32 __s32;
+typedef s64 __s64;
+
+typedef s64 ktime_t;
+typedef unsigned int gfp_t;
+
+#define __rcu
+#define __percpu
+#define __user
+#define __force
+#undef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+
+#define GFP_KERNEL 0
+
+/******************** HELPERS ********************/
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define clamp(val, lo, hi) min(max(val, lo), hi)
+#define swap(a, b) do { __typeof__(a) __t = (a); (a) = (b); (b) = __t; } while (0)
+#define min_t(type, a, b) min((type)(a), (type)(b))
+#define max_t(type, a, b) max((type)(a), (type)(b))
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define U64_MAX UINT64_MAX
+#define S64_MAX INT64_MAX
+#define S32_MAX INT32_MAX
+#define S32_MIN INT32_MIN
+#define U32_MAX UINT32_MAX
+#define BIT(n) (1UL << (n))
+#define rol32(w, s) (((u32)(w) << (s)) | ((u32)(w) >> (32 - (s))))
+
+#define abs(x) ({ __typeof__(x) __x = (x); __x < 0 ? -__x : __x; })
+
+#define container_of(ptr, type, member) \
+        ((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, val) (*(volatile __typeof__(x) *)&(x) = (val))
+
+#define smp_wmb() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_rmb() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define cpu_relax() __builtin_ia32_pause()
+
+#define PAGE_SIZE 4096UL
+#define PAGE_ALIGN(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+static inline unsigned long roundup_pow_of_two(unsigned long n)
+{
+        return (n <= 1) ? 1 : 1UL << (64 - __builtin_clzl(n - 1));
+}
+
+static inline int fls64(u64 x)
+{
+        return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+/******************** MATH ********************/
+
+#define USEC_PER_MSEC 1000ULL
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_SEC  1000000000ULL
+
+static inline u64 div_u64(u64 dividend, u32 divisor) { return dividend / divisor; }
+static inline s64 div_s64(s64 dividend, s32 divisor) { return dividend / divisor; }
+static inline u64 div64_u64(u64 dividend, u64 divisor) { return dividend / divisor; }
+
+static inline u64 mul_u64_u32_shr(u64 a, u32 mul, unsigned int shift)
+{
+        return (u64)(((unsigned __int128)a * mul) >> shift);
+}
+
+static inline u64 div64_u64_rem(u64 dividend, u64 divisor, u64 *remainder)
+{
+        *remainder = dividend % divisor;
+        return dividend / divisor;
+}
+
+/******************** MEMORY ********************/
+
+static inline void *kzalloc(size_t size, gfp_t flags)
+{
+        (void)flags;
+        return calloc(1, size);
+}
+
+static inline void kfree(const void *p)
+{
+        free((void *)p);
+}
+
+static inline void *kvcalloc(size_t n, size_t size, gfp_t flags)
+{
+        (void)flags;
+        return calloc(n, size);
+}
+
+static inline void *kvmalloc(size_t size, gfp_t flags)
+{
+        (void)flags;
+        return malloc(size);
+}
+
+static inline void *kvmalloc_array(size_t n, size_t size, gfp_t flags)
+{
+        (void)flags;
+        return malloc(n * size);
+}
+
+static inline void kvfree(const void *p)
+{
+        free((void *)p);
+}
+
+static inline void *vmalloc_user(unsigned long size)
+{
+        void *p = aligned_alloc(PAGE_SIZE, PAGE_ALIGN(size));
+
+        if (p)
+                memset(p, 0, PAGE_ALIGN(size));
+        return p;
+}
+
+static inline void vfree(const void *p)
+{
+        free((void *)p);
+}
+
+/* Enough of the VMA for the mmap() handler to compile, it can't succeed */
+#define VM_WRITE     0x2UL
+#define VM_MAYWRITE  0x20UL
+#define VM_DONTEXPAND 0x40000UL
+#define VM_DONTDUMP  0x4000000UL
+
+struct vm_area_struct;
+struct vm_operations_struct {
+        void (*open)(struct vm_area_struct *vma);
+        void (*close)(struct vm_area_struct *vma);
+};
+struct vm_area_struct {
+        unsigned long vm_flags;
+        unsigned long vm_pgoff;
+        void *vm_private_data;
+        const struct vm_operations_struct *vm_ops;
+};
+
+static inline void vm_flags_set(struct vm_area_struct *vma, unsigned long flags) { vma->vm_flags |= flags; }
+static inline void vm_flags_clear(struct vm_area_struct *vma, unsigned long flags) { vma->vm_flags &= ~flags; }
+
+static inline int remap_vmalloc_range(struct vm_area_struct *vma, void *addr, unsigned long pgoff)
+{
+        (void)vma; (void)addr; (void)pgoff;
+        return -ENODEV;
+}
+
+/******************** ATOMICS ********************/
+
+typedef struct { int counter; } atomic_t;
+
+#define atomic_set(v, i) __atomic_store_n(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic_read(v)   __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic_inc(v)    __atomic_fetch_add(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic_dec(v)    __atomic_fetch_sub(&(v)->counter, 1, __ATOMIC_RELAXED)
+
+/******************** LOCKS ********************/
+
+/* Spinning, like the real thing, so contention costs look alike */
+typedef struct { int locked; } spinlock_t;
+
+static inline void spin_lock_init(spinlock_t *lock) { lock->locked = 0; }
+
+static inline void spin_lock(spinlock_t *lock)
+{
+        while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE))
+                while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED))
+                        cpu_relax();
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+        __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+/* There are no bottom halves on the host */
+#define spin_lock_bh(lock)   spin_lock(lock)
+#define spin_unlock_bh(lock) spin_unlock(lock)
+
+struct mutex { pthread_mutex_t m; };
+
+#define mutex_init(lock)    pthread_mutex_init(&(lock)->m, NULL)
+#define mutex_destroy(lock) pthread_mutex_destroy(&(lock)->m)
+#define mutex_lock(lock)    pthread_mutex_lock(&(lock)->m)
+#define mutex_unlock(lock)  pthread_mutex_unlock(&(lock)->m)
+
+#define lockdep_is_held(lock) 1
+
+/******************** RCU ********************/
+
+extern pthread_rwlock_t kshim_rcu_lock;
+
+#define rcu_read_lock()   pthread_rwlock_rdlock(&kshim_rcu_lock)
+#define rcu_read_unlock() pthread_rwlock_unlock(&kshim_rcu_lock)
+
+static inline void synchronize_rcu(void)
+{
+        pthread_rwlock_wrlock(&kshim_rcu_lock);
+        pthread_rwlock_unlock(&kshim_rcu_lock);
+}
+
+#define rcu_dereference(p)               __atomic_load_n(&(p), __ATOMIC_CONSUME)
+#define rcu_dereference_protected(p, c)  (p)
+#define rcu_assign_pointer(p, v)         __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define RCU_INIT_POINTER(p, v)           ((p) = (v))
+
+/******************** TIME ********************/
+
+static inline s64 ktime_to_ns(ktime_t kt) { return kt; }
+
+static inline ktime_t ktime_get_boottime(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_BOOTTIME, &ts);
+        return (s64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline u64 ktime_get_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/******************** RANDOM ********************/
+
+u32 get_random_u32(void);
+
+static inline u32 get_random_u32_below(u32 ceil)
+{
+        return (u32)(((u64)get_random_u32() * ceil) >> 32);
+}
+
+/******************** FIXED POINT ********************/
+
+/* A table lookup of whole degrees like the kernel's, the table is filled
+ * from libm on first use */
+s32 fixp_sin32(int degrees);
+
+#endif